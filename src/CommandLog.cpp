@@ -0,0 +1,666 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CommandLog.h"
+#include "NaviEngine.h"
+
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+
+using namespace naviengine;
+
+namespace
+{
+/** Identifies a command log file and its format version */
+const char MAGIC[8] = { 'N', 'A', 'V', 'I', 'C', 'M', 'D', '3' };
+
+/**
+ * Append an unsigned integer, seven bits per byte with the low bits first
+ */
+void putNumber(std::string& out, uint64_t number)
+{
+    while (number >= 0x80)
+    {
+        out += (char) ((number & 0x7f) | 0x80);
+        number >>= 7;
+    }
+    out += (char) number;
+}
+
+/**
+ * Read an unsigned integer written by putNumber
+ *
+ * @return false if the data ends before the integer
+ */
+bool getNumber(const char*& data, const char* end, uint64_t& number)
+{
+    number = 0;
+    for (int shift = 0; data < end && shift < 64; shift += 7)
+    {
+        unsigned char byte = *data++;
+        number |= (uint64_t) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+/** Map a signed integer to an unsigned one, keeping small negatives small */
+uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+int64_t unzigzag(uint64_t value)
+{
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+/**
+ * Append a string preceded by its length
+ */
+void putString(std::string& out, const std::string& text)
+{
+    putNumber(out, text.size());
+    out += text;
+}
+
+/**
+ * Read a string written by putString
+ *
+ * @return false if the data ends before the string
+ */
+bool getString(const char*& data, const char* end, std::string& text)
+{
+    uint64_t length;
+    if (not getNumber(data, end, length) || length > (uint64_t) (end - data))
+        return false;
+    text.assign(data, length);
+    data += length;
+    return true;
+}
+
+/**
+ * Append a list of positions preceded by their number
+ */
+void putPositions(std::string& out, const std::vector<int>& positions)
+{
+    putNumber(out, positions.size());
+    for (size_t i = 0; i < positions.size(); ++i)
+        putNumber(out, zigzag(positions[i]));
+}
+
+/**
+ * Read a list of positions written by putPositions
+ *
+ * @return false if the data ends before the list
+ */
+bool getPositions(const char*& data, const char* end, std::vector<int>& positions)
+{
+    uint64_t count, number;
+    if (not getNumber(data, end, count) || count > (uint64_t) (end - data))
+        return false;
+    positions.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (not getNumber(data, end, number))
+            return false;
+        positions[i] = unzigzag(number);
+    }
+    return true;
+}
+}
+
+/**
+ * Constructor
+ */
+CommandLog::CommandLog() :
+        file_(NULL), start_(0), last_(0), count_(0), pending_(false), failed_(false)
+{
+}
+
+/**
+ * Destructor
+ *
+ * Closes the log.
+ */
+CommandLog::~CommandLog()
+{
+    close();
+}
+
+/**
+ * Start recording to a file
+ *
+ * An open log is closed first. Times are recorded from now.
+ *
+ * @param path The file to write, replaced if it exists
+ * @return true on success, otherwise false
+ */
+bool CommandLog::open(const std::string& path)
+{
+    close();
+    file_ = fopen(path.c_str(), "wb");
+    if (file_ == NULL)
+        return false;
+    if (fwrite(MAGIC, sizeof(MAGIC), 1, file_) != 1)
+    {
+        fclose(file_);
+        file_ = NULL;
+        return false;
+    }
+    start_ = last_ = now();
+    count_ = 0;
+    pending_ = false;
+    failed_ = false;
+    return true;
+}
+
+/**
+ * Stop recording
+ *
+ * A command that has not returned yet is not recorded.
+ *
+ * @return false if a record could not be written since the log was opened, otherwise true
+ */
+bool CommandLog::close()
+{
+    pending_ = false;
+    if (file_ != NULL)
+    {
+        if (fclose(file_) != 0)
+            failed_ = true;
+        file_ = NULL;
+    }
+    return not failed_;
+}
+
+/**
+ * Check if the log is recording
+ *
+ * @return true if a file is open, otherwise false
+ */
+bool CommandLog::isOpen() const
+{
+    return file_ != NULL;
+}
+
+/**
+ * Get the number of commands recorded since the log was opened
+ *
+ * @return The number of records
+ */
+size_t CommandLog::size() const
+{
+    return count_;
+}
+
+/**
+ * Start recording a command given now
+ *
+ * The record is written by end when the command returns. Does nothing if
+ * the log is not open.
+ *
+ * @param command The command
+ * @param value The position of the child of SELECT_URI and SELECT_ID, or the command of PROCESS
+ * @param uri The uri of SELECT_URI or of the model of OPEN_MENU and OPEN_SHARED_MENU
+ * @return true if the command is recorded, otherwise false
+ */
+bool CommandLog::begin(Command command, int64_t value, const std::string& uri)
+{
+    pending_ = false;
+    if (file_ == NULL)
+        return false;
+
+    uint64_t time = now();
+    record_.clear();
+    putNumber(record_, time - last_);
+    putNumber(record_, command);
+    last_ = time;
+
+    if (command == SELECT_URI)
+    {
+        putString(record_, uri);
+        putNumber(record_, zigzag(value));
+    }
+    else if (command == SELECT_ID || command == PROCESS)
+    {
+        putNumber(record_, zigzag(value));
+    }
+    else if (command == OPEN_MENU || command == OPEN_SHARED_MENU)
+    {
+        putString(record_, uri);
+    }
+    pending_ = true;
+    return true;
+}
+
+/**
+ * Record the payload size of a PROCESS command
+ *
+ * The payload itself is not recorded, as it may hold pointers.
+ *
+ * @param data The payload, or NULL if there is none
+ * @param size The size of the payload, or -1 if it is not known
+ */
+void CommandLog::addPayload(const void* data, int64_t size)
+{
+    if (not pending_)
+        return;
+    if (data == NULL)
+        putNumber(record_, 0);
+    else if (size < 0)
+        putNumber(record_, 1);
+    else
+        putNumber(record_, size + 2);
+}
+
+/**
+ * Record the uris of a SELECT_PATH command
+ *
+ * @param uris The uris of the path
+ */
+void CommandLog::addPath(const std::vector<std::string>& uris)
+{
+    if (not pending_)
+        return;
+    putNumber(record_, uris.size());
+    for (size_t i = 0; i < uris.size(); ++i)
+        putString(record_, uris[i]);
+}
+
+/**
+ * Record the child positions of a SELECT_INDICES command
+ *
+ * @param indices The child positions of the path
+ */
+void CommandLog::addPath(const std::vector<int>& indices)
+{
+    if (pending_)
+        putPositions(record_, indices);
+}
+
+/**
+ * Write the record of the running command with the state it ended in
+ *
+ * Each record is flushed, so a log is complete up to the last command even
+ * if the application does not close it. If the record can not be written
+ * the log is closed and close reports the failure.
+ *
+ * @param menus The number of open menus
+ * @param path The child positions from the model of the current menu to the current node
+ * @param choice The position of the current choice, or -1 if there is none
+ * @return true if the record was written, otherwise false
+ */
+bool CommandLog::end(uint64_t menus, const std::vector<int>& path, int choice)
+{
+    if (not pending_ || file_ == NULL)
+        return false;
+    pending_ = false;
+
+    putNumber(record_, menus);
+    putPositions(record_, path);
+    putNumber(record_, zigzag(choice));
+    if (fwrite(record_.data(), record_.size(), 1, file_) != 1 || fflush(file_) != 0)
+    {
+        failed_ = true;
+        fclose(file_);
+        file_ = NULL;
+        return false;
+    }
+    count_++;
+    return true;
+}
+
+/**
+ * Check if a command has started and not yet been written
+ *
+ * @return true if end is expected, otherwise false
+ */
+bool CommandLog::pending() const
+{
+    return pending_;
+}
+
+/**
+ * Read a command log
+ *
+ * @param path The file to read
+ * @param entries Filled with the recorded commands in order
+ * @return false if the file could not be read or is not a complete command log, otherwise true
+ */
+bool CommandLog::read(const std::string& path, std::vector<Entry>& entries)
+{
+    entries.clear();
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+        return false;
+
+    std::string data;
+    char buffer[65536];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.append(buffer, length);
+    fclose(file);
+
+    if (data.size() < sizeof(MAGIC) || memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0)
+        return false;
+
+    const char* next = data.data() + sizeof(MAGIC);
+    const char* end = data.data() + data.size();
+    uint64_t time = 0;
+    while (next < end)
+    {
+        Entry entry;
+        uint64_t delta, command, number;
+        if (not getNumber(next, end, delta) || not getNumber(next, end, command))
+            return false;
+        time += delta;
+        entry.time = time;
+        entry.command = (Command) command;
+        entry.value = 0;
+        entry.size = 0;
+
+        if (command == SELECT_URI)
+        {
+            if (not getString(next, end, entry.uri) || not getNumber(next, end, number))
+                return false;
+            entry.value = unzigzag(number);
+        }
+        else if (command == SELECT_ID)
+        {
+            if (not getNumber(next, end, number))
+                return false;
+            entry.value = unzigzag(number);
+        }
+        else if (command == PROCESS)
+        {
+            if (not getNumber(next, end, number))
+                return false;
+            entry.value = unzigzag(number);
+            if (not getNumber(next, end, number))
+                return false;
+            if (number == 1)
+                entry.size = -1;
+            else if (number > 1)
+                entry.size = number - 2;
+        }
+        else if (command == OPEN_MENU || command == OPEN_SHARED_MENU)
+        {
+            if (not getString(next, end, entry.uri))
+                return false;
+        }
+        else if (command == SELECT_PATH)
+        {
+            if (not getNumber(next, end, number) || number > (uint64_t) (end - next))
+                return false;
+            entry.uris.resize(number);
+            for (size_t i = 0; i < entry.uris.size(); ++i)
+            {
+                if (not getString(next, end, entry.uris[i]))
+                    return false;
+            }
+        }
+        else if (command == SELECT_INDICES)
+        {
+            if (not getPositions(next, end, entry.indices))
+                return false;
+        }
+        else if (command < TOP || command > OPEN_PUBLISHED_MENU)
+        {
+            return false;
+        }
+
+        if (not getNumber(next, end, entry.menus) || not getPositions(next, end, entry.path)
+                || not getNumber(next, end, number))
+            return false;
+        entry.choice = unzigzag(number);
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+/**
+ * Give recorded commands to an engine and measure them
+ *
+ * The engine must have the model the commands were recorded on open, but
+ * the model may have been built anew. SELECT_ID and SELECT_URI select the
+ * child at the recorded position, so children are found even though their
+ * ids and default uris differ, except for virtual children which are
+ * selected by uri. The models of opened menus and the payloads of PROCESS
+ * commands are taken from the source, with the size that was recorded.
+ *
+ * @param navi The engine to give the commands to
+ * @param entries The commands, as read from a log
+ * @param realTime If true, each command is given at its recorded time, otherwise as soon as the previous one returns
+ * @param results Filled with the outcome of each command
+ * @param source Supplies the models and payloads, or NULL to supply none
+ * @return The number of commands after which the engine was not in the recorded state
+ */
+size_t CommandLog::replay(NaviEngine& navi, const std::vector<Entry>& entries, bool realTime,
+        std::vector<Result>& results, ReplaySource* source)
+{
+    results.clear();
+    results.reserve(entries.size());
+    ReplaySource none;
+    if (source == NULL)
+        source = &none;
+    size_t diverged = 0;
+    std::vector<int> path;
+    int choice;
+    uint64_t start = now();
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        const Entry& entry = entries[i];
+        if (realTime)
+        {
+            uint64_t time = now() - start;
+            if (entry.time > time)
+            {
+                uint64_t wait = entry.time - time;
+                struct timespec delay;
+                delay.tv_sec = wait / 1000000000;
+                delay.tv_nsec = wait % 1000000000;
+                nanosleep(&delay, NULL);
+            }
+        }
+
+        // Find the recorded child before the clock starts
+        AnyNode* node = navi.numberOfMenus() > 0 ? navi.getCurrentNode() : NULL;
+        std::string uri = entry.uri;
+        uint64_t id = 0;
+        if (node != NULL && entry.value >= 0 && entry.value <= INT_MAX)
+        {
+            if (entry.command == SELECT_ID)
+            {
+                id = node->childId(entry.value);
+            }
+            else if (entry.command == SELECT_URI && not node->isVirtual())
+            {
+                AnyNode* child = node->childAt(entry.value);
+                if (child != NULL)
+                    uri = child->uri_;
+            }
+        }
+        void* payload = NULL;
+        AnyNode* menu = NULL;
+        ModelPublisher* publisher = NULL;
+        if (entry.command == PROCESS)
+            payload = source->payload(entry);
+        else if (entry.command == OPEN_MENU || entry.command == OPEN_SHARED_MENU)
+            menu = source->menu(entry);
+        else if (entry.command == OPEN_PUBLISHED_MENU)
+            publisher = source->publisher(entry);
+
+        Result result;
+        result.success = false;
+        uint64_t begin = now();
+        switch (entry.command)
+        {
+        case TOP:
+            result.success = navi.top();
+            break;
+        case UP:
+            result.success = navi.up();
+            break;
+        case SELECT:
+            result.success = navi.select();
+            break;
+        case SELECT_URI:
+            result.success = navi.selectNodeByUri(uri);
+            break;
+        case SELECT_ID:
+            result.success = navi.selectNodeById(id);
+            break;
+        case NEXT:
+            result.success = navi.next();
+            break;
+        case PREV:
+            result.success = navi.prev();
+            break;
+        case OPEN_CONTEXT_MENU:
+            result.success = navi.openContextMenu();
+            break;
+        case CLOSE_MENU:
+            result.success = navi.closeMenu();
+            break;
+        case BACK:
+            result.success = navi.back();
+            break;
+        case FORWARD:
+            result.success = navi.forward();
+            break;
+        case PROCESS:
+            if (entry.size < 0)
+                result.success = navi.process(entry.value, payload);
+            else
+                result.success = navi.process(entry.value, payload, entry.size);
+            break;
+        case BEGIN_BATCH:
+            navi.beginBatch();
+            result.success = true;
+            break;
+        case COMMIT:
+            result.success = navi.commit();
+            break;
+        case OPEN_MENU:
+            result.success = navi.openMenu(menu);
+            break;
+        case OPEN_SHARED_MENU:
+            result.success = navi.openSharedMenu(menu);
+            break;
+        case OPEN_PUBLISHED_MENU:
+            result.success = navi.openPublishedMenu(publisher);
+            break;
+        case SELECT_PATH:
+            result.success = navi.selectPath(entry.uris);
+            break;
+        case SELECT_INDICES:
+            result.success = navi.selectPath(entry.indices);
+            break;
+        }
+        result.latency = now() - begin;
+
+        navi.commandState(path, choice);
+        result.diverged = (uint64_t) navi.numberOfMenus() != entry.menus || path != entry.path
+                || choice != entry.choice;
+        if (result.diverged)
+            diverged++;
+        results.push_back(result);
+    }
+    return diverged;
+}
+
+/**
+ * Get the name of a command
+ *
+ * @param command The command
+ * @return The name of the engine function giving the command
+ */
+const char* CommandLog::name(Command command)
+{
+    switch (command)
+    {
+    case TOP:
+        return "top";
+    case UP:
+        return "up";
+    case SELECT:
+        return "select";
+    case SELECT_URI:
+        return "selectNodeByUri";
+    case SELECT_ID:
+        return "selectNodeById";
+    case NEXT:
+        return "next";
+    case PREV:
+        return "prev";
+    case OPEN_CONTEXT_MENU:
+        return "openContextMenu";
+    case CLOSE_MENU:
+        return "closeMenu";
+    case BACK:
+        return "back";
+    case FORWARD:
+        return "forward";
+    case PROCESS:
+        return "process";
+    case BEGIN_BATCH:
+        return "beginBatch";
+    case COMMIT:
+        return "commit";
+    case OPEN_MENU:
+        return "openMenu";
+    case SELECT_PATH:
+        return "selectPath";
+    case SELECT_INDICES:
+        return "selectPath(indices)";
+    case OPEN_SHARED_MENU:
+        return "openSharedMenu";
+    case OPEN_PUBLISHED_MENU:
+        return "openPublishedMenu";
+    }
+    return "unknown";
+}
+
+/**
+ * Get a monotonic time in nanoseconds
+ */
+uint64_t CommandLog::now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+void* ReplaySource::payload(const CommandLog::Entry& /* entry */)
+{
+    return NULL;
+}
+
+AnyNode* ReplaySource::menu(const CommandLog::Entry& /* entry */)
+{
+    return NULL;
+}
+
+ModelPublisher* ReplaySource::publisher(const CommandLog::Entry& /* entry */)
+{
+    return NULL;
+}
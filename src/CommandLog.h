@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAVIENGINE_COMMANDLOG
+#define NAVIENGINE_COMMANDLOG
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace naviengine
+{
+
+class AnyNode;
+class ModelPublisher;
+class NaviEngine;
+class ReplaySource;
+
+/**
+ * A compact binary log of the commands given to an engine.
+ *
+ * Given to NaviEngine::setCommandLog, the log records each command the
+ * application gives the engine with the time it was given, so a user session
+ * can be replayed against a saved model to measure the latency of each
+ * command. Commands that nodes give the engine while a command runs are not
+ * recorded, as replaying the outer command gives them again.
+ *
+ * Each record is the time since the previous record in nanoseconds and the
+ * command as variable length integers, followed by the arguments of the
+ * command and the state of the engine when the command returned. Children
+ * are recorded by their position rather than their id, so a log can be
+ * replayed on a model built anew, and replay reports the commands after
+ * which the engine did not end in the recorded state. Only the size of the
+ * data object of a process command is recorded, as it may hold pointers
+ * that are not valid on replay. The application supplies the data objects
+ * and the models of opened menus on replay, see ReplaySource.
+ */
+class CommandLog
+{
+public:
+    /**
+     * The commands that are recorded
+     */
+    enum Command
+    {
+        TOP = 1,
+        UP = 2,
+        SELECT = 3,
+        SELECT_URI = 4,
+        SELECT_ID = 5,
+        NEXT = 6,
+        PREV = 7,
+        OPEN_CONTEXT_MENU = 8,
+        CLOSE_MENU = 9,
+        BACK = 10,
+        FORWARD = 11,
+        PROCESS = 12,
+        BEGIN_BATCH = 13,
+        COMMIT = 14,
+        OPEN_MENU = 15,
+        SELECT_PATH = 16,
+        SELECT_INDICES = 17,
+        OPEN_SHARED_MENU = 18,
+        OPEN_PUBLISHED_MENU = 19
+    };
+
+    /**
+     * A data type to hold a recorded command
+     */
+    struct Entry
+    {
+        /** The time since recording started in nanoseconds */
+        uint64_t time;
+        Command command;
+        /** The position of the child for SELECT_URI and SELECT_ID, or -1 if it was not found, or the command of PROCESS */
+        int64_t value;
+        /** The uri of SELECT_URI or the uri of the model of OPEN_MENU and OPEN_SHARED_MENU */
+        std::string uri;
+        /** The uris of SELECT_PATH */
+        std::vector<std::string> uris;
+        /** The child positions of SELECT_INDICES */
+        std::vector<int> indices;
+        /** The payload size of PROCESS, 0 if it had none or -1 if the size is unknown */
+        int64_t size;
+        /** The number of open menus when the command returned */
+        uint64_t menus;
+        /** The child positions from the model of the current menu to the current node */
+        std::vector<int> path;
+        /** The position of the current choice, or -1 if there is none */
+        int choice;
+    };
+
+    /**
+     * A data type to hold the outcome of a replayed command
+     */
+    struct Result
+    {
+        /** The time the command took in nanoseconds */
+        uint64_t latency;
+        /** The value the command returned */
+        bool success;
+        /** True if the engine did not end in the recorded state */
+        bool diverged;
+    };
+
+    CommandLog();
+    ~CommandLog();
+
+    bool open(const std::string& path);
+    bool close();
+    bool isOpen() const;
+    size_t size() const;
+
+    bool begin(Command command, int64_t value = 0, const std::string& uri = std::string());
+    void addPayload(const void* data, int64_t size);
+    void addPath(const std::vector<std::string>& uris);
+    void addPath(const std::vector<int>& indices);
+    bool end(uint64_t menus, const std::vector<int>& path, int choice);
+    bool pending() const;
+
+    static bool read(const std::string& path, std::vector<Entry>& entries);
+    static size_t replay(NaviEngine& navi, const std::vector<Entry>& entries, bool realTime,
+            std::vector<Result>& results, ReplaySource* source = NULL);
+    static const char* name(Command command);
+
+private:
+    CommandLog(const CommandLog&);
+    CommandLog& operator=(const CommandLog&);
+
+    static uint64_t now();
+
+    FILE* file_;
+    /** The time recording started */
+    uint64_t start_;
+    /** The time of the last record */
+    uint64_t last_;
+    size_t count_;
+    /** The record of the running command, written when it returns */
+    std::string record_;
+    bool pending_;
+    /** True if a record could not be written since the log was opened */
+    bool failed_;
+};
+
+/**
+ * Supplies what a command log does not hold when it is replayed.
+ *
+ * By default no data objects, models or publishers are supplied, so the
+ * commands opening menus fail and process commands get no data object.
+ */
+class ReplaySource
+{
+public:
+    virtual ~ReplaySource()
+    {
+    }
+
+    /**
+     * Give the data object of a process command
+     *
+     * @param entry The command, with the command the node shall process in value and the recorded size in size
+     * @return The data object, or NULL to give none
+     */
+    virtual void* payload(const CommandLog::Entry& entry);
+
+    /**
+     * Give the model of an openMenu or openSharedMenu command
+     *
+     * @param entry The command, with the uri of the recorded model in uri
+     * @return The model, owned by the engine for OPEN_MENU, or NULL if there is none
+     */
+    virtual AnyNode* menu(const CommandLog::Entry& entry);
+
+    /**
+     * Give the publisher of an openPublishedMenu command
+     *
+     * @param entry The command
+     * @return The publisher, or NULL if there is none
+     */
+    virtual ModelPublisher* publisher(const CommandLog::Entry& entry);
+};
+}
+#endif
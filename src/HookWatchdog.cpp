@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "HookWatchdog.h"
+
+#include <cxxabi.h>
+#include <stdlib.h>
+#include <time.h>
+
+using namespace naviengine;
+
+namespace
+{
+/**
+ * Get the readable name of a type
+ *
+ * @param mangled The mangled name of the type
+ * @return The demangled name, or the mangled name if it can not be demangled
+ */
+std::string demangle(const std::string& mangled)
+{
+    int status = 0;
+    char* name = abi::__cxa_demangle(mangled.c_str(), NULL, NULL, &status);
+    if (name == NULL)
+        return mangled;
+    std::string readable(name);
+    free(name);
+    return readable;
+}
+}
+
+/**
+ * Constructor
+ *
+ * No hook has a budget
+ */
+HookWatchdog::HookWatchdog()
+{
+    for (int i = 0; i < HOOKS; ++i)
+        budgets_[i] = 0;
+}
+
+/**
+ * Set the budget of a hook
+ *
+ * @param hook The hook
+ * @param microseconds The time an invocation may take, or 0 for no limit
+ */
+void HookWatchdog::setBudget(NaviEngine::Hook hook, unsigned int microseconds)
+{
+    if (hook >= 0 && hook < HOOKS)
+        budgets_[hook] = (uint64_t) microseconds * 1000;
+}
+
+/**
+ * Start timing a hook invocation
+ *
+ * The type is taken before the hook runs, as the hook may delete its node.
+ *
+ * @param node The node whose hook is invoked
+ * @return The timing to check when the hook returns
+ */
+HookTiming HookWatchdog::start(const AnyNode* node) const
+{
+    HookTiming timing;
+    timing.type = &typeid(*node);
+    timing.start = now();
+    return timing;
+}
+
+/**
+ * Check a hook invocation against the budget of the hook
+ *
+ * @param hook The hook that was invoked
+ * @param timing The timing returned by start
+ * @return true if the invocation exceeded the budget, otherwise false
+ */
+bool HookWatchdog::check(NaviEngine::Hook hook, const HookTiming& timing)
+{
+    if (hook < 0 || hook >= HOOKS || budgets_[hook] == 0)
+        return false;
+
+    uint64_t elapsed = now() - timing.start;
+    if (elapsed <= budgets_[hook])
+        return false;
+
+    std::string type(timing.type->name());
+    Counter& counter = counters_[std::make_pair(type, (int) hook)];
+    unsigned int microseconds = elapsed / 1000;
+    if (counter.count++ == 0 || microseconds > counter.worst)
+        counter.worst = microseconds;
+    if (hook == NaviEngine::HOOK_NARRATE)
+        fallback_.insert(type);
+    return true;
+}
+
+/**
+ * Check if a node is narrated by the engine instead of by its hooks
+ *
+ * @param node The node to narrate
+ * @return true if onNarrate of the node type exceeded its budget, otherwise false
+ */
+bool HookWatchdog::fallback(const AnyNode* node) const
+{
+    if (fallback_.empty())
+        return false;
+    return fallback_.count(typeid(*node).name()) > 0;
+}
+
+/**
+ * Get the budget violations
+ *
+ * @param out Filled with one entry per node type and hook, ordered by type
+ */
+void HookWatchdog::violations(std::vector<NaviEngine::HookViolation>& out) const
+{
+    out.clear();
+    std::map<std::pair<std::string, int>, Counter>::const_iterator it;
+    for (it = counters_.begin(); it != counters_.end(); ++it)
+    {
+        NaviEngine::HookViolation violation;
+        violation.type = demangle(it->first.first);
+        violation.hook = (NaviEngine::Hook) it->first.second;
+        violation.count = it->second.count;
+        violation.worst = it->second.worst;
+        out.push_back(violation);
+    }
+}
+
+/**
+ * Clear the violation counters and narrate all nodes by their hooks again
+ */
+void HookWatchdog::reset()
+{
+    counters_.clear();
+    fallback_.clear();
+}
+
+/**
+ * Get a monotonic time in nanoseconds
+ */
+uint64_t HookWatchdog::now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000 + time.tv_nsec;
+}
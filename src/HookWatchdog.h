@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAVIENGINE_HOOKWATCHDOG
+#define NAVIENGINE_HOOKWATCHDOG
+
+#include "NaviEngine.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace naviengine
+{
+
+/**
+ * The start of a timed hook invocation
+ */
+struct HookTiming
+{
+    /** The type of the node, NULL if the hook is not timed */
+    const std::type_info* type;
+    /** The monotonic start time in nanoseconds */
+    uint64_t start;
+};
+
+/**
+ * HookWatchdog measures node hooks against per hook time budgets.
+ *
+ * Invocations that take longer than the budget of their hook are counted
+ * per node type. Node types whose onNarrate exceeded its budget are
+ * narrated by the engine instead until the counters are reset.
+ */
+class HookWatchdog
+{
+public:
+    HookWatchdog();
+
+    void setBudget(NaviEngine::Hook hook, unsigned int microseconds);
+
+    HookTiming start(const AnyNode* node) const;
+    bool check(NaviEngine::Hook hook, const HookTiming& timing);
+    bool fallback(const AnyNode* node) const;
+
+    void violations(std::vector<NaviEngine::HookViolation>& out) const;
+    void reset();
+
+private:
+    static uint64_t now();
+
+    /** The number of hooks that can be given a budget */
+    static const int HOOKS = 4;
+
+    /**
+     * The violations of one hook by one node type
+     */
+    struct Counter
+    {
+        unsigned int count;
+        unsigned int worst;
+    };
+
+    /** The budget of each hook in nanoseconds, 0 if it has none */
+    uint64_t budgets_[HOOKS];
+    /** Counters by mangled node type name and hook */
+    std::map<std::pair<std::string, int>, Counter> counters_;
+    /** Mangled names of node types narrated by the engine */
+    std::set<std::string> fallback_;
+};
+}
+#endif
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MemoryBudget.h"
+#include "Nodes/AnyNode.h"
+
+using namespace naviengine;
+
+/**
+ * Remove this node from the memory budget that tracks it
+ */
+void AnyNode::leaveBudget()
+{
+    budgetEntry_->budget->forget(this);
+}
+
+/**
+ * Constructor
+ *
+ * @param limit The number of bytes opened nodes may hold before nodes are evicted
+ */
+MemoryBudget::MemoryBudget(size_t limit) :
+        newest_(NULL), oldest_(NULL), count_(0), used_(0), limit_(limit)
+{
+}
+
+/**
+ * Destructor
+ *
+ * Stops tracking all nodes, no node is evicted
+ */
+MemoryBudget::~MemoryBudget()
+{
+    while (newest_ != NULL)
+        forget(newest_->node);
+}
+
+/**
+ * Set the limit
+ *
+ * @param limit The number of bytes opened nodes may hold before nodes are evicted
+ */
+void MemoryBudget::setLimit(size_t limit)
+{
+    limit_ = limit;
+}
+
+/**
+ * Get the limit
+ *
+ * @return The number of bytes opened nodes may hold before nodes are evicted
+ */
+size_t MemoryBudget::limit() const
+{
+    return limit_;
+}
+
+/**
+ * Get the memory in use
+ *
+ * @return The approximate number of bytes held by the tracked nodes
+ */
+size_t MemoryBudget::used() const
+{
+    return used_;
+}
+
+/**
+ * Measure a node and mark it as the most recently opened node
+ *
+ * The node is measured together with its children, but not their children,
+ * which are measured when the children are opened. The children are only
+ * measured again if the children generation of the node has changed, so
+ * opening a large menu again does not walk its children.
+ *
+ * @param node The node that was opened
+ */
+void MemoryBudget::touch(AnyNode* node)
+{
+    BudgetEntry* entry = node->budgetEntry_;
+    if (entry != NULL && entry->budget != this)
+    {
+        entry->budget->forget(node);
+        entry = NULL;
+    }
+
+    if (entry == NULL)
+    {
+        entry = new BudgetEntry;
+        entry->node = node;
+        entry->bytes = 0;
+        entry->childBytes = 0;
+        entry->generation = 0;
+        entry->budget = this;
+        node->budgetEntry_ = entry;
+        count_++;
+    }
+    else
+    {
+        unlink(entry);
+    }
+
+    // A node without a generation may have changed its children unnoticed
+    unsigned int generation = node->childrenGeneration();
+    if (generation == 0 || generation != entry->generation)
+    {
+        entry->childBytes = 0;
+        const AnyNode* child = node->firstChild();
+        if (child != NULL)
+        {
+            do
+            {
+                entry->childBytes += child->memoryUsage();
+                child = child->next_;
+            } while (child != node->firstChild() && child != NULL);
+        }
+        entry->generation = generation;
+    }
+
+    size_t bytes = node->memoryUsage() + entry->childBytes;
+    used_ -= entry->bytes;
+    entry->bytes = bytes;
+    used_ += bytes;
+    link(entry);
+}
+
+/**
+ * Stop tracking a node
+ *
+ * @param node The node to forget
+ */
+void MemoryBudget::forget(AnyNode* node)
+{
+    BudgetEntry* entry = node->budgetEntry_;
+    if (entry == NULL || entry->budget != this)
+        return;
+
+    unlink(entry);
+    used_ -= entry->bytes;
+    count_--;
+    node->budgetEntry_ = NULL;
+    delete entry;
+}
+
+/**
+ * Evict the least recently opened nodes until the memory in use is within the limit
+ *
+ * Nodes that are kept or refuse eviction are moved to the most recently
+ * opened end, so each node is considered at most once.
+ *
+ * @param keep Nodes that must not be evicted
+ */
+void MemoryBudget::evict(const std::set<const AnyNode*>& keep)
+{
+    size_t candidates = count_;
+    while (used_ > limit_ && candidates > 0 && oldest_ != NULL)
+    {
+        BudgetEntry* entry = oldest_;
+        AnyNode* node = entry->node;
+        candidates--;
+
+        if (keep.count(node) == 0 && node->evict())
+        {
+            // The children deleted by evict have already left the budget
+            forget(node);
+        }
+        else
+        {
+            unlink(entry);
+            link(entry);
+        }
+    }
+}
+
+void MemoryBudget::link(BudgetEntry* entry)
+{
+    entry->older = newest_;
+    entry->newer = NULL;
+    if (newest_ != NULL)
+        newest_->newer = entry;
+    newest_ = entry;
+    if (oldest_ == NULL)
+        oldest_ = entry;
+}
+
+void MemoryBudget::unlink(BudgetEntry* entry)
+{
+    if (entry->newer != NULL)
+        entry->newer->older = entry->older;
+    else
+        newest_ = entry->older;
+
+    if (entry->older != NULL)
+        entry->older->newer = entry->newer;
+    else
+        oldest_ = entry->newer;
+}
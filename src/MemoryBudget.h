@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAVIENGINE_MEMORYBUDGET
+#define NAVIENGINE_MEMORYBUDGET
+
+#include <set>
+#include <cstddef>
+
+namespace naviengine
+{
+
+class AnyNode;
+class MemoryBudget;
+
+/**
+ * A node tracked by a MemoryBudget
+ */
+struct BudgetEntry
+{
+    MemoryBudget* budget;
+    AnyNode* node;
+    size_t bytes;
+    /** The measured bytes of the children */
+    size_t childBytes;
+    /** The children generation of the node when the children were measured */
+    unsigned int generation;
+    BudgetEntry* newer;
+    BudgetEntry* older;
+};
+
+/**
+ * MemoryBudget keeps track of the approximate memory held by opened nodes.
+ *
+ * Nodes are kept in least recently opened order. When the memory in use
+ * exceeds the limit, AnyNode::evict is invoked on the least recently opened
+ * nodes until enough memory has been released. A tracked node that is
+ * deleted removes itself from the budget. The children of a node are only
+ * measured again when its children generation has changed.
+ */
+class MemoryBudget
+{
+public:
+    MemoryBudget(size_t limit);
+    ~MemoryBudget();
+
+    void setLimit(size_t limit);
+    size_t limit() const;
+    size_t used() const;
+
+    void touch(AnyNode* node);
+    void forget(AnyNode* node);
+    void evict(const std::set<const AnyNode*>& keep);
+
+private:
+    void link(BudgetEntry* entry);
+    void unlink(BudgetEntry* entry);
+
+    BudgetEntry* newest_;
+    BudgetEntry* oldest_;
+    size_t count_;
+    size_t used_;
+    size_t limit_;
+};
+}
+#endif
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ModelBuilder.h"
+#include "Nodes/MenuNode.h"
+
+#include <unistd.h>
+
+using namespace naviengine;
+
+/**
+ * Constructor
+ *
+ * Starts the threads
+ *
+ * @param threads The number of threads, or 0 for one per online processor
+ */
+ModelBuilder::ModelBuilder(unsigned int threads) :
+        pending_(0), stop_(false)
+{
+    if (threads == 0)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (processors > 0) ? processors : 1;
+    }
+
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&wake_, NULL);
+    pthread_cond_init(&done_, NULL);
+    for (unsigned int i = 0; i < threads; ++i)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, ModelBuilder::run, this) == 0)
+            threads_.push_back(thread);
+    }
+}
+
+/**
+ * Destructor
+ *
+ * Waits for subtrees being built, deletes the subtrees that were not spliced
+ * and joins the threads
+ */
+ModelBuilder::~ModelBuilder()
+{
+    wait();
+
+    pthread_mutex_lock(&mutex_);
+    stop_ = true;
+    pthread_cond_broadcast(&wake_);
+    pthread_mutex_unlock(&mutex_);
+
+    for (size_t i = 0; i < threads_.size(); ++i)
+        pthread_join(threads_[i], NULL);
+
+    for (size_t i = 0; i < subtrees_.size(); ++i)
+    {
+        delete subtrees_[i];
+        delete builders_[i];
+    }
+    pthread_cond_destroy(&done_);
+    pthread_cond_destroy(&wake_);
+    pthread_mutex_destroy(&mutex_);
+}
+
+/**
+ * Get the number of threads building subtrees
+ *
+ * @return The number of threads
+ */
+unsigned int ModelBuilder::threads() const
+{
+    return threads_.size();
+}
+
+/**
+ * Add a subtree to build
+ *
+ * If no thread could be started, the subtree is built on the calling thread.
+ *
+ * @param builder The builder of the subtree, the model builder takes ownership
+ */
+void ModelBuilder::add(SubtreeBuilder* builder)
+{
+    pthread_mutex_lock(&mutex_);
+    builders_.push_back(builder);
+    subtrees_.push_back(NULL);
+    if (threads_.empty())
+    {
+        pthread_mutex_unlock(&mutex_);
+        subtrees_.back() = builder->build();
+        return;
+    }
+
+    queue_.push_back(builders_.size() - 1);
+    pending_++;
+    pthread_cond_signal(&wake_);
+    pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Add the subtrees built since the last splice to a parent
+ *
+ * Waits until all subtrees are built. The subtrees are added in the order
+ * they were added to the builder, as by one call to MenuNode::addNodes.
+ *
+ * @param parent The node to add the subtrees to
+ * @return true if all subtrees were built, otherwise false. Subtrees that
+ * were built are added in either case.
+ */
+bool ModelBuilder::splice(MenuNode* parent)
+{
+    wait();
+
+    std::vector<AnyNode*> nodes;
+    nodes.reserve(subtrees_.size());
+    for (size_t i = 0; i < subtrees_.size(); ++i)
+    {
+        if (subtrees_[i] != NULL)
+            nodes.push_back(subtrees_[i]);
+        delete builders_[i];
+    }
+    bool success = nodes.size() == subtrees_.size();
+    subtrees_.clear();
+    builders_.clear();
+
+    parent->addNodes(nodes);
+    return success;
+}
+
+/**
+ * Wait until all added subtrees are built
+ */
+void ModelBuilder::wait()
+{
+    pthread_mutex_lock(&mutex_);
+    while (pending_ > 0)
+        pthread_cond_wait(&done_, &mutex_);
+    pthread_mutex_unlock(&mutex_);
+}
+
+void* ModelBuilder::run(void* builder)
+{
+    static_cast<ModelBuilder*>(builder)->work();
+    return NULL;
+}
+
+/**
+ * Build subtrees until stopped
+ */
+void ModelBuilder::work()
+{
+    pthread_mutex_lock(&mutex_);
+    while (not stop_)
+    {
+        if (queue_.empty())
+        {
+            pthread_cond_wait(&wake_, &mutex_);
+            continue;
+        }
+
+        size_t index = queue_.front();
+        queue_.pop_front();
+        SubtreeBuilder* builder = builders_[index];
+        pthread_mutex_unlock(&mutex_);
+
+        AnyNode* subtree = builder->build();
+
+        pthread_mutex_lock(&mutex_);
+        subtrees_[index] = subtree;
+        if (--pending_ == 0)
+            pthread_cond_broadcast(&done_);
+    }
+    pthread_mutex_unlock(&mutex_);
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAVIENGINE_MODELBUILDER
+#define NAVIENGINE_MODELBUILDER
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+namespace naviengine
+{
+
+class AnyNode;
+class MenuNode;
+
+/**
+ * Builds one subtree of a model for ModelBuilder.
+ */
+class SubtreeBuilder
+{
+public:
+    virtual ~SubtreeBuilder()
+    {
+    }
+
+    /**
+     * Build the subtree
+     *
+     * Runs on a thread of the builder. The subtree must not be linked to any
+     * other node while it is built.
+     *
+     * @return The root of the subtree, or NULL on failure
+     */
+    virtual AnyNode* build() = 0;
+};
+
+/**
+ * ModelBuilder builds independent subtrees of a model on a pool of threads.
+ *
+ * Subtrees are added with add and built in parallel. splice waits for them
+ * and adds them to a parent in one step, in the order they were added. Only
+ * splice touches nodes outside the subtrees, on the calling thread.
+ */
+class ModelBuilder
+{
+public:
+    ModelBuilder(unsigned int threads = 0);
+    ~ModelBuilder();
+
+    unsigned int threads() const;
+
+    void add(SubtreeBuilder* builder);
+    bool splice(MenuNode* parent);
+
+private:
+    ModelBuilder(const ModelBuilder&);
+    ModelBuilder& operator=(const ModelBuilder&);
+
+    static void* run(void* builder);
+    void work();
+    void wait();
+
+    std::vector<pthread_t> threads_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t wake_;
+    pthread_cond_t done_;
+    /** Indices of the subtrees waiting to be built */
+    std::deque<size_t> queue_;
+    std::vector<SubtreeBuilder*> builders_;
+    std::vector<AnyNode*> subtrees_;
+    size_t pending_;
+    bool stop_;
+};
+}
+#endif
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ModelPublisher.h"
+#include "Nodes/AnyNode.h"
+
+using namespace naviengine;
+
+/**
+ * Constructor
+ *
+ * @param root The first version of the model, the publisher takes ownership
+ */
+ModelPublisher::ModelPublisher(AnyNode* root)
+{
+    pthread_mutex_init(&mutex_, NULL);
+    current_ = new ModelVersion;
+    current_->root = root;
+    current_->number = 1;
+    current_->readers = 0;
+}
+
+/**
+ * Destructor
+ *
+ * Deletes the current version. All engines navigating the publisher's
+ * models must have been destroyed before the publisher.
+ */
+ModelPublisher::~ModelPublisher()
+{
+    AnyNode::destroy(current_->root);
+    delete current_;
+    pthread_mutex_destroy(&mutex_);
+}
+
+/**
+ * Publish a new version of the model
+ *
+ * The previous version is deleted now if no engine navigates it, otherwise
+ * when the last engine has switched to a newer version.
+ *
+ * @param root The new version of the model, the publisher takes ownership
+ */
+void ModelPublisher::publish(AnyNode* root)
+{
+    ModelVersion* version = new ModelVersion;
+    version->root = root;
+    version->readers = 0;
+
+    pthread_mutex_lock(&mutex_);
+    ModelVersion* old = current_;
+    version->number = old->number + 1;
+    current_ = version;
+    bool unused = (old->readers == 0);
+    pthread_mutex_unlock(&mutex_);
+
+    if (unused)
+    {
+        AnyNode::destroy(old->root);
+        delete old;
+    }
+}
+
+/**
+ * Get the current version number
+ *
+ * @return The number of the most recently published version
+ */
+unsigned int ModelPublisher::version()
+{
+    pthread_mutex_lock(&mutex_);
+    unsigned int number = current_->number;
+    pthread_mutex_unlock(&mutex_);
+    return number;
+}
+
+/**
+ * Start navigating the current version
+ *
+ * @return The current version, which stays valid until it is released
+ */
+ModelVersion* ModelPublisher::acquire()
+{
+    pthread_mutex_lock(&mutex_);
+    ModelVersion* version = current_;
+    version->readers++;
+    pthread_mutex_unlock(&mutex_);
+    return version;
+}
+
+/**
+ * Stop navigating a version
+ *
+ * @param version A version returned by acquire
+ */
+void ModelPublisher::release(ModelVersion* version)
+{
+    pthread_mutex_lock(&mutex_);
+    bool unused = (--version->readers == 0 && version != current_);
+    pthread_mutex_unlock(&mutex_);
+
+    if (unused)
+    {
+        AnyNode::destroy(version->root);
+        delete version;
+    }
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAVIENGINE_MODELPUBLISHER
+#define NAVIENGINE_MODELPUBLISHER
+
+#include <pthread.h>
+
+namespace naviengine
+{
+
+class AnyNode;
+
+/**
+ * A published version of a model
+ */
+struct ModelVersion
+{
+    /** The root of the model */
+    AnyNode* root;
+    /** The version number, increasing with each publication */
+    unsigned int number;
+    /** The number of engines navigating this version */
+    int readers;
+};
+
+/**
+ * ModelPublisher replaces a model while engines keep navigating it.
+ *
+ * A writer builds a new model and publishes it. Engines that opened the
+ * publisher with NaviEngine::openPublishedMenu switch to the new version at
+ * the start of their next command and map their state to it by uri. A
+ * version is deleted when it is no longer the current one and no engine
+ * navigates it. Uris must therefore identify the same node across versions.
+ */
+class ModelPublisher
+{
+public:
+    ModelPublisher(AnyNode* root);
+    ~ModelPublisher();
+
+    void publish(AnyNode* root);
+    unsigned int version();
+
+    ModelVersion* acquire();
+    void release(ModelVersion* version);
+
+private:
+    pthread_mutex_t mutex_;
+    ModelVersion* current_;
+};
+}
+#endif
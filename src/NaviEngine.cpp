@@ -18,32 +18,166 @@
  */
 
 #include "NaviEngine.h"
+#include "NodePreparer.h"
+#include "MemoryBudget.h"
+#include "ModelPublisher.h"
+#include "OpenCompletions.h"
+#include "HookWatchdog.h"
+#include "CommandLog.h"
+#include "UriIndex.h"
+#include "Trace.h"
+
+#include <algorithm>
 
 using namespace naviengine;
 
+namespace naviengine
+{
+/**
+ * Marks the extent of a command. Commands invoked by nodes while another
+ * command is running are part of the outer command.
+ */
+class CommandScope
+{
+public:
+    CommandScope(NaviEngine& navi, const char* name) :
+            trace_(name, navi.menuStack.empty() ? NULL : navi.menuStack.back().state.currentNode, navi.menuStack.size()), navi_(navi)
+    {
+        navi_.beginCommand();
+    }
+
+    ~CommandScope()
+    {
+        navi_.endCommand();
+    }
+
+private:
+    TraceScope trace_;
+    NaviEngine& navi_;
+};
+
+/**
+ * Get the position of a node among its siblings
+ *
+ * @return The position starting from 1
+ */
 int currentSibling(const AnyNode* node)
 {
-    if (node->parent_->firstChild() == NULL)
+    return node->parent_->indexOf(node) + 1;
+}
+
+/**
+ * Add a node and its ancestors to a set of nodes
+ */
+void keepPath(std::set<const AnyNode*>& path, const AnyNode* node)
+{
+    for (; node != NULL; node = node->parent_)
+        path.insert(node);
+}
+
+/**
+ * Get a child of a node by its uri
+ *
+ * @return The child, or NULL if there is no such child
+ */
+AnyNode* childByUri(const AnyNode* node, const std::string& uri)
+{
+    AnyNode* child = node->firstChild();
+    while (child != NULL && child->uri_ != uri)
     {
-        return 0;
+        child = child->next_;
+        if (child == node->firstChild())
+            child = NULL;
+    }
+    return child;
+}
+
+/**
+ * Get the position of a child among the children of a node by its id
+ *
+ * @return The position starting from 0, or -1 if there is no such child
+ */
+int positionOfId(AnyNode* node, uint64_t id)
+{
+    if (node->isVirtual())
+    {
+        int count = node->numberOfChildren();
+        for (int n = 0; n < count; ++n)
+        {
+            if (node->childId(n) == id)
+                return n;
+        }
+        return -1;
+    }
+
+    AnyNode* first = node->firstChild();
+    AnyNode* child = first;
+    for (int n = 0; child != NULL; ++n)
+    {
+        if (child->id_ == id)
+            return n;
+        child = child->next_;
+        if (child == first)
+            child = NULL;
     }
+    return -1;
+}
 
-    const AnyNode* tmp = node;
-    int num = 1;
-    while (tmp != node->parent_->firstChild() && tmp != NULL)
+/**
+ * Get the position of a child among the children of a node by its uri
+ *
+ * @return The position starting from 0, or -1 if there is no such child
+ */
+int positionOfUri(AnyNode* node, const std::string& uri)
+{
+    int count = node->numberOfChildren();
+    for (int n = 0; n < count; ++n)
     {
-        tmp = tmp->prev_;
-        num++;
+        if (node->childUri(n) == uri)
+            return n;
     }
+    return -1;
+}
+
+/**
+ * Find a node of an old version of a published model in another version
+ *
+ * The node is looked up by the uris of its ancestors from the root.
+ *
+ * @param node The node to find
+ * @param oldRoot The root of the old version
+ * @param newRoot The root of the version to find the node in
+ * @param found Set to false if only an ancestor of the node was found
+ * @return The node or its closest remaining ancestor, or NULL if the node is not part of the old version
+ */
+AnyNode* nodeInVersion(const AnyNode* node, const AnyNode* oldRoot, AnyNode* newRoot, bool& found)
+{
+    std::vector<const std::string*> path;
+    for (; node != NULL && node != oldRoot; node = node->parent_)
+        path.push_back(&node->uri_);
+    if (node == NULL)
+        return NULL;
 
-    return num;
+    AnyNode* mapped = newRoot;
+    found = true;
+    while (found && not path.empty())
+    {
+        AnyNode* child = childByUri(mapped, *path.back());
+        path.pop_back();
+        if (child != NULL)
+            mapped = child;
+        else
+            found = false;
+    }
+    return mapped;
+}
 }
 
 /**
  * Constructor
  */
 NaviEngine::NaviEngine() :
-        good_(false), openOnChange_(true)
+        good_(false), batchDepth_(0), batchMenus_(0), commandDepth_(0), commandMenus_(0), commandTrail_(0), preparer_(NULL), budget_(NULL), publisher_(NULL), version_(NULL), deltaPending_(false), deltaMenus_(0), historySize_(0), historyCursor_(0), historyMoving_(false), uriIndex_(NULL), completions_(new OpenCompletions()), pendingNode_(NULL), pendingModel_(NULL), pendingTicket_(0), lastTicket_(0), loadingPending_(false), watchdog_(NULL), commandLog_(NULL)
 {
 }
 
@@ -54,11 +188,22 @@ NaviEngine::NaviEngine() :
  */
 NaviEngine::~NaviEngine()
 {
+    abortOpen(NULL);
+    delete preparer_;
+    delete budget_;
+    delete watchdog_;
     while (not menuStack.empty())
     {
-        delete menuStack.top().menuModel;
-        menuStack.pop();
+        if (menuStack.back().ownsModel)
+            AnyNode::destroy(menuStack.back().menuModel);
+        menuStack.pop_back();
+        trails_.pop_back();
     }
+    for (size_t i = 0; i < batchClosed_.size(); ++i)
+        AnyNode::destroy(batchClosed_[i]);
+    if (publisher_ != NULL)
+        publisher_->release(version_);
+    delete completions_;
 }
 
 /**
@@ -74,11 +219,70 @@ bool NaviEngine::good() const
 /**
  * Open a menu
  *
+ * The engine takes ownership of the model and deletes it when the menu is closed.
+ *
  * @param node The menu node to open
  * @param narrable If true, narrate functions are called
  * @return true on success, otherwise false
  */
 bool NaviEngine::openMenu(AnyNode* node, bool narrable)
+{
+    CommandScope scope(*this, "openMenu");
+    logCommand(CommandLog::OPEN_MENU, 0, node != NULL ? node->uri_ : std::string());
+    return pushMenu(node, narrable, true);
+}
+
+/**
+ * Open a menu with a model shared by several engines
+ *
+ * The model is not deleted when the menu is closed. All navigation state is
+ * kept in the engine, so engines on different threads can navigate the same
+ * model concurrently as long as the nodes do not change the model in their
+ * hooks. The memory budget is not applied to shared models.
+ *
+ * @param node The menu node to open
+ * @param narrable If true, narrate functions are called
+ * @return true on success, otherwise false
+ */
+bool NaviEngine::openSharedMenu(AnyNode* node, bool narrable)
+{
+    CommandScope scope(*this, "openSharedMenu");
+    logCommand(CommandLog::OPEN_SHARED_MENU, 0, node != NULL ? node->uri_ : std::string());
+    return pushMenu(node, narrable, false);
+}
+
+/**
+ * Open the current version of a published model as the root menu
+ *
+ * The engine switches to a newer version at the start of the first command
+ * after it has been published, see ModelPublisher. Published models are
+ * shared, see openSharedMenu.
+ *
+ * @param publisher The publisher of the model, it must outlive the engine
+ * @param narrable If true, narrate functions are called
+ * @return true on success, false if a menu is already open
+ */
+bool NaviEngine::openPublishedMenu(ModelPublisher* publisher, bool narrable)
+{
+    CommandScope scope(*this, "openPublishedMenu");
+    logCommand(CommandLog::OPEN_PUBLISHED_MENU);
+    if (publisher == NULL || not menuStack.empty())
+        return false;
+
+    publisher_ = publisher;
+    version_ = publisher->acquire();
+    return pushMenu(version_->root, narrable, false);
+}
+
+/**
+ * Push a menu on the menu stack and open it
+ *
+ * @param node The menu node to open
+ * @param narrable If true, narrate functions are called
+ * @param owned If true, the model is deleted when the menu is closed
+ * @return true on success, otherwise false
+ */
+bool NaviEngine::pushMenu(AnyNode* node, bool narrable, bool owned)
 {
     if (node == 0)
         return false;
@@ -87,16 +291,16 @@ bool NaviEngine::openMenu(AnyNode* node, bool narrable)
 
     MenuState menu;
     menu.menuModel = node;
+    menu.ownsModel = owned;
     menu.state.currentNode = node;
     menu.state.currentChoice = node->firstChild();
-    menuStack.push(menu);
+    menuStack.push_back(menu);
+    trails_.push_back(std::vector<selection_type>());
 
     if (narrable)
     {
-        node->beforeOnOpen();
-        narrateShortPause();
-        good_ = node->onOpen(*this);
-        narrateChange(before, menuStack.top());
+        good_ = openNode(node);
+        announceChange(before, menuStack.back());
     }
 
     return good_;
@@ -109,19 +313,23 @@ bool NaviEngine::openMenu(AnyNode* node, bool narrable)
  */
 bool NaviEngine::closeMenu()
 {
+    CommandScope scope(*this, "closeMenu");
+    logCommand(CommandLog::CLOSE_MENU);
     if (menuStack.size() > 1)
     {
-        MenuState menu = menuStack.top();
-        delete menu.menuModel;
-        menu.menuModel = NULL;
-        menuStack.pop();
+        MenuState menu = menuStack.back();
+        menuStack.pop_back();
+        trails_.pop_back();
+        releaseModel(menu.menuModel, menu.ownsModel);
 
         return true; // This means the menu was closed
     }
 
-    MenuState& menu = menuStack.top();
+    MenuState& menu = menuStack.back();
     menu.state.currentNode = menu.menuModel; // Fix the root menu state if someone borked it.
     menu.state.currentChoice = menu.state.currentNode->firstChild();
+    menu.state.currentChild = 0;
+    trails_.back().clear();
 
     return false; // No menu closed
 }
@@ -130,92 +338,1372 @@ bool NaviEngine::closeMenu()
  * Invokes onNarrate for the current node
  *
  * If onNarrate returns false NaviEngine will render the node
- * with the help of it's virtual narrate functions and the nodes narrate methods
+ * with the help of it's virtual narrate functions and the nodes narrate methods.
+ * Nothing is narrated inside a batch.
  */
 void NaviEngine::narrateNode()
 {
-    MenuState& menu = menuStack.top();
-    if (not menu.state.currentNode->onNarrate())
+    CommandScope scope(*this, "narrateNode");
+    if (batchDepth_ > 0)
+        return;
+
+    MenuState& menu = menuStack.back();
+    bool fallback = narrateFallback(menu.state.currentNode);
+    bool narrated = false;
+    if (not fallback)
+    {
+        HookTiming timing = startHook(menu.state.currentNode);
+        {
+            TraceScope trace("onNarrate", menu.state.currentNode, menuStack.size());
+            narrated = menu.state.currentNode->onNarrate();
+        }
+        endHook(HOOK_NARRATE, menu.state.currentNode, timing);
+    }
+    if (not narrated)
+    {
+        if (fallback || not menu.state.currentNode->narrateName())
+            narrate(menu.state.currentNode->name_.c_str());
+        narrateShortPause();
+        narrateNode(menu.state.currentChoice);
+    }
+}
+
+/**
+ * Invoke onNarrate for a node
+ *
+ * If onNarrate returns false NaviEngine will render the node
+ * with the help of it's virtual narrate functions and the nodes narrate methods
+ *
+ * @param choice A pointer the to choice to narrate
+ */
+void NaviEngine::narrateNode(AnyNode* node)
+{
+    if (node == 0 || batchDepth_ > 0)
+        return;
+
+    CommandScope scope(*this, "narrateNode");
+    bool fallback = narrateFallback(node);
+    bool narrated = false;
+    if (not fallback)
+    {
+        HookTiming timing = startHook(node);
+        {
+            TraceScope trace("onNarrate", node, menuStack.size());
+            narrated = node->onNarrate();
+        }
+        endHook(HOOK_NARRATE, node, timing);
+    }
+    if (not narrated)
+    {
+        if (fallback || not node->narrateName())
+        {
+            // A choice shown by another node than its parent, e.g. a view,
+            // is narrated at its position in that node
+            AnyNode* container = menuStack.back().state.currentNode;
+            int position = 0;
+            if (node == menuStack.back().state.currentChoice && container != NULL && container != node->parent_)
+                position = container->currentPosition(*this);
+
+            if (position == 0)
+                position = currentSibling(node);
+            narrate(position);
+            narrate(node->name_);
+            narrateLongPause();
+        }
+    }
+}
+
+/**
+ * Invoke onRender for a node
+ *
+ * Nodes are not rendered inside a batch.
+ *
+ * @param node A pointer the the node to render
+ * @return The result from the onRender invoke
+ */
+bool NaviEngine::renderNode(AnyNode* node)
+{
+    if (node == NULL || batchDepth_ > 0)
+        return false;
+
+    CommandScope scope(*this, "renderNode");
+    HookTiming timing = startHook(node);
+    bool selfRendered;
+    {
+        TraceScope trace("onRender", node, menuStack.size());
+        selfRendered = node->onRender();
+    }
+    endHook(HOOK_RENDER, node, timing);
+    return not selfRendered;
+}
+
+/**
+ * Go to the root (top) node
+ *
+ * Menus stacked above the bottom menu are popped in one go and the bottom
+ * menu is reset to its root, so no intermediate node is opened or narrated.
+ * The models of the popped menus are deleted after the new state is narrated.
+ *
+ * @return true on success, otherwise false
+ */
+bool NaviEngine::top()
+{
+    CommandScope scope(*this, "top");
+    logCommand(CommandLog::TOP);
+    MenuState before = menuStack.back();
+    if (batchDepth_ == 0)
+        narrateStop();
+
+    std::vector<MenuState> closedMenus;
+    while (menuStack.size() > 1)
+    {
+        closedMenus.push_back(menuStack.back());
+        menuStack.pop_back();
+        trails_.pop_back();
+    }
+
+    MenuState& menu = menuStack.back();
+    if (menu.state.currentNode != menu.menuModel)
+    {
+        // The new choice is the node right below the root on the path to the
+        // current node, which may be shared by several parents
+        AnyNode* choice = NULL;
+        if (not trails_.back().empty())
+        {
+            choice = trails_.back().front().currentChoice;
+        }
+        else
+        {
+            choice = menu.state.currentNode;
+            while (choice != NULL && choice->parent_ != menu.menuModel)
+                choice = choice->parent_;
+        }
+
+        menu.state.currentNode = menu.menuModel;
+        menu.state.currentChild = 0;
+        trails_.back().clear();
+        if (choice != NULL)
+            menu.state.currentChoice = choice;
+        else
+            menu.state.currentChoice = menu.menuModel->firstChild();
+    }
+
+    good_ = openNode(menu.state.currentNode);
+    announceChange(before, menuStack.back());
+
+    for (size_t i = 0; i < closedMenus.size(); ++i)
+        releaseModel(closedMenus[i].menuModel, closedMenus[i].ownsModel);
+
+    return true;
+}
+
+/**
+ * Forget a model whose menu has been closed and delete it if it is owned
+ *
+ * Inside a batch the model is deleted when the batch is committed, as the
+ * state the batch started in may refer to it until then.
+ *
+ * @param model The model of the closed menu
+ * @param owned If true, the engine owns the model
+ */
+void NaviEngine::releaseModel(AnyNode* model, bool owned)
+{
+    forgetHistory(model);
+    abortOpen(model);
+    if (not owned)
+        return;
+    if (batchDepth_ > 0)
+        batchClosed_.push_back(model);
+    else
+        AnyNode::destroy(model);
+}
+
+/**
+ * Start a batch of commands
+ *
+ * Until the matching commit, commands do not narrate, render or open nodes.
+ * Use selectPath inside a batch to descend into nodes that build their
+ * children when opened. Batches can be nested; only the outermost commit
+ * takes effect.
+ */
+void NaviEngine::beginBatch()
+{
+    if (batchDepth_++ == 0)
+    {
+        batchBefore_ = menuStack.back();
+        batchMenus_ = menuStack.size();
+    }
+    if (commandDepth_ == 0 && logCommand(CommandLog::BEGIN_BATCH))
+        logState();
+}
+
+/**
+ * End a batch of commands
+ *
+ * When the outermost batch ends, the node the batch ended on is opened if it
+ * differs from the node the batch started on, and the change is narrated once.
+ * Menus closed during the batch have their models deleted after that.
+ *
+ * @return the result from onOpen if a node was opened, false if no batch was started, otherwise true
+ */
+bool NaviEngine::commit()
+{
+    CommandScope scope(*this, "commit");
+    logCommand(CommandLog::COMMIT);
+    if (batchDepth_ == 0)
+        return false;
+    if (--batchDepth_ > 0)
+        return true;
+
+    MenuState& now = menuStack.back();
+    bool success = true;
+    if (now.state.currentNode != batchBefore_.state.currentNode || menuStack.size() != batchMenus_)
+    {
+        good_ = openNode(now.state.currentNode);
+        success = good_;
+    }
+
+    if (stateHasChanged(batchBefore_) || now.state.currentChoice != batchBefore_.state.currentChoice
+            || menuStack.size() != batchMenus_)
+    {
+        narrateChange(batchBefore_, menuStack.back());
+    }
+
+    // The state the batch started in no longer refers to the closed models
+    for (size_t i = 0; i < batchClosed_.size(); ++i)
+        AnyNode::destroy(batchClosed_[i]);
+    batchClosed_.clear();
+
+    return success;
+}
+
+/**
+ * Check if a batch of commands is in progress
+ *
+ * @return true inside a batch, otherwise false
+ */
+bool NaviEngine::inBatch() const
+{
+    return batchDepth_ > 0;
+}
+
+/**
+ * Invoke beforeOnOpen and onOpen for a node
+ *
+ * Nodes are not opened inside a batch; the node a batch ends on is opened
+ * when the batch is committed.
+ *
+ * @param node The node to open
+ * @return the result from onOpen, or true if the node was not opened
+ */
+bool NaviEngine::openNode(AnyNode* node)
+{
+    if (batchDepth_ > 0)
+        return true;
+
+    HookTiming timing = startHook(node);
+    {
+        TraceScope trace("beforeOnOpen", node, menuStack.size());
+        node->beforeOnOpen();
+    }
+    narrateShortPause();
+    bool opened;
+    {
+        TraceScope trace("onOpen", node, menuStack.size());
+        opened = node->onOpen(*this);
+    }
+    if (endHook(HOOK_OPEN, node, timing))
+        opened = false;
+    accountOpened(node);
+    return opened;
+}
+
+/**
+ * Defer the open of a node until its data has been loaded
+ *
+ * Nodes that load their children from disk or network call this from
+ * onOpen, start loading on another thread and return true. After the
+ * command, narrateLoading is called while the node is still loading. The
+ * loading thread calls completeOpen with the returned ticket when it is
+ * done, and AnyNode::onOpenComplete is invoked on the engine thread when
+ * the completion is delivered. If the user navigates away from the node
+ * first, AnyNode::abort is invoked and the completion is ignored. Only one
+ * open can be deferred at a time; deferring another aborts the first.
+ *
+ * @param node The node being opened
+ * @return The ticket to complete the open with, or 0 if node is NULL
+ */
+unsigned long NaviEngine::deferOpen(AnyNode* node)
+{
+    if (node == NULL || menuStack.empty())
+        return 0;
+
+    abortOpen(NULL);
+    pendingNode_ = node;
+    __atomic_store_n(&pendingNode_->opening_, this, __ATOMIC_RELEASE);
+    pendingModel_ = menuStack.back().menuModel;
+    pendingTicket_ = ++lastTicket_;
+    loadingPending_ = true;
+    return pendingTicket_;
+}
+
+/**
+ * Complete a deferred open, safe to call from any thread
+ *
+ * The completion is queued until deliverCompletions is called on the engine
+ * thread. openCompleted is called from the calling thread to let the engine
+ * thread know.
+ *
+ * @param ticket The ticket returned by deferOpen
+ */
+void NaviEngine::completeOpen(unsigned long ticket)
+{
+    completions_->add(ticket);
+    openCompleted();
+}
+
+/**
+ * Deliver completed opens on the engine thread
+ *
+ * Invokes AnyNode::onOpenComplete for the deferred node if its open has
+ * been completed. The first child becomes the current choice if the node
+ * had none, and the change is narrated if the node is in the top menu.
+ * Completions of aborted opens are dropped.
+ *
+ * @return true if an open was completed, otherwise false
+ */
+bool NaviEngine::deliverCompletions()
+{
+    std::vector<unsigned long> tickets;
+    if (not completions_->take(tickets) || pendingNode_ == NULL)
+        return false;
+    if (std::find(tickets.begin(), tickets.end(), pendingTicket_) == tickets.end())
+        return false;
+
+    CommandScope scope(*this, "deliverCompletions");
+    AnyNode* node = pendingNode_;
+    __sync_bool_compare_and_swap(&node->opening_, this, (NaviEngine*) NULL);
+    pendingNode_ = NULL;
+    pendingTicket_ = 0;
+    loadingPending_ = false;
+
+    size_t index = menuStack.size();
+    while (index > 0 && menuStack[index - 1].state.currentNode != node)
+        --index;
+    if (index == 0)
+        return false;
+
+    MenuState before = menuStack[index - 1];
+    HookTiming timing = startHook(node);
+    {
+        TraceScope trace("onOpenComplete", node, menuStack.size());
+        good_ = node->onOpenComplete(*this);
+    }
+    endHook(HOOK_OPEN, node, timing);
+    MenuState& menu = menuStack[index - 1];
+    if (menu.state.currentNode == node && menu.state.currentChoice == NULL && not node->isVirtual())
+        menu.state.currentChoice = node->firstChild();
+    markDirty(node, CHILDREN_CHANGED);
+    if (index == menuStack.size())
+        announceChange(before, menuStack.back());
+    return good_;
+}
+
+/**
+ * Check if an open is deferred
+ *
+ * @return true if a node is loading, otherwise false
+ */
+bool NaviEngine::openPending() const
+{
+    return pendingNode_ != NULL;
+}
+
+/**
+ * Default narrateLoading, narrates "loading"
+ *
+ * @param node The node that is loading
+ */
+void NaviEngine::narrateLoading(const AnyNode* /* node */)
+{
+    narrate("loading");
+}
+
+/**
+ * Default openCompleted, does nothing
+ */
+void NaviEngine::openCompleted()
+{
+}
+
+/**
+ * Abort the deferred open
+ *
+ * @param model Abort only if the open was started in the menu with this model, or NULL to abort anyway
+ */
+void NaviEngine::abortOpen(const AnyNode* model)
+{
+    if (pendingNode_ == NULL || (model != NULL && model != pendingModel_))
+        return;
+
+    AnyNode* node = pendingNode_;
+    __sync_bool_compare_and_swap(&node->opening_, this, (NaviEngine*) NULL);
+    pendingNode_ = NULL;
+    pendingTicket_ = 0;
+    loadingPending_ = false;
+    TraceScope trace("abort", node, menuStack.size());
+    node->abort();
+}
+
+/**
+ * Cancel the deferred open of a node that is being deleted
+ *
+ * The node is not aborted, as its own destructor has already run; a node
+ * deleted while loading must stop its loading itself. The completion of
+ * the open is ignored.
+ *
+ * @param node The node being deleted
+ */
+void NaviEngine::forgetOpen(const AnyNode* node)
+{
+    if (node != pendingNode_)
+        return;
+
+    pendingNode_ = NULL;
+    pendingTicket_ = 0;
+    loadingPending_ = false;
+}
+
+/**
+ * Cancel the deferred open of this node in the engine waiting for it
+ */
+void AnyNode::leaveOpen()
+{
+    NaviEngine* engine = __atomic_exchange_n(&opening_, (NaviEngine*) NULL, __ATOMIC_ACQ_REL);
+    if (engine != NULL)
+        engine->forgetOpen(this);
+}
+
+/**
+ * Abort the deferred open if the user navigated away from the node, or
+ * narrate that it is loading after the command that deferred it
+ */
+void NaviEngine::checkPendingOpen()
+{
+    if (pendingNode_ == NULL)
+        return;
+
+    bool current = false;
+    for (size_t i = 0; i < menuStack.size() && not current; ++i)
+        current = menuStack[i].state.currentNode == pendingNode_;
+    if (not current)
+    {
+        abortOpen(NULL);
+    }
+    else if (loadingPending_ && batchDepth_ == 0 && menuStack.back().state.currentNode == pendingNode_)
+    {
+        loadingPending_ = false;
+        TraceScope trace("narrateLoading", pendingNode_, menuStack.size());
+        narrateLoading(pendingNode_);
+    }
+}
+
+/**
+ * Record the commands given to the engine
+ *
+ * Each command the application gives is recorded with the time it was
+ * given and the state it ended in, see CommandLog. Commands given by nodes
+ * while a command runs are not recorded.
+ *
+ * @param log The log to record to, not owned by the engine, or NULL to stop recording
+ */
+void NaviEngine::setCommandLog(CommandLog* log)
+{
+    commandLog_ = log;
+}
+
+/**
+ * Start recording a command if it was given by the application
+ *
+ * The record is completed by logState when the command returns.
+ *
+ * @param command The CommandLog::Command
+ * @param value The id of a selectNodeById command or the command of a process command
+ * @param uri The uri of a selectNodeByUri command or of the model of an openMenu or openSharedMenu command
+ * @return true if the command is recorded, otherwise false
+ */
+bool NaviEngine::logCommand(int command, int64_t value, const std::string& uri)
+{
+    if (commandLog_ == NULL)
+        return false;
+    // beginBatch runs outside of a command scope
+    if (commandDepth_ > (command == CommandLog::BEGIN_BATCH ? 0 : 1))
+        return false;
+
+    // Children are recorded by position, ids and default uris differ between models
+    AnyNode* node = menuStack.empty() ? NULL : menuStack.back().state.currentNode;
+    if (command == CommandLog::SELECT_ID)
+    {
+        value = (node != NULL) ? positionOfId(node, value) : -1;
+    }
+    else if (command == CommandLog::SELECT_URI)
+    {
+        AnyNode* child = (node != NULL && not node->isVirtual()) ? childByUri(node, uri) : NULL;
+        value = (child != NULL) ? node->indexOf(child) : -1;
+    }
+    return commandLog_->begin((CommandLog::Command) command, value, uri);
+}
+
+/**
+ * Complete the record of a command with the state it ended in
+ */
+void NaviEngine::logState()
+{
+    if (commandLog_ == NULL || not commandLog_->pending())
+        return;
+
+    std::vector<int> path;
+    int choice;
+    commandState(path, choice);
+    commandLog_->end(menuStack.size(), path, choice);
+}
+
+/**
+ * Get the state of the current menu by child positions
+ *
+ * @param path Filled with the position of each node from the model of the current menu to the current node
+ * @param choice The position of the current choice, or -1 if there is none
+ */
+void NaviEngine::commandState(std::vector<int>& path, int& choice)
+{
+    path.clear();
+    choice = -1;
+    if (menuStack.empty())
+        return;
+
+    const std::vector<selection_type>& trail = trails_.back();
+    path.resize(trail.size());
+    for (size_t i = 0; i < trail.size(); ++i)
+        path[i] = trail[i].currentNode->indexOf(trail[i].currentChoice);
+
+    const selection_type& state = menuStack.back().state;
+    choice = state.currentNode->isVirtual() ? state.currentChild : choiceIndex(state);
+}
+
+/**
+ * Limit the time a node hook may take
+ *
+ * Each invocation of the hook is measured. Invocations that take longer
+ * than the budget are counted per node type, see hookViolations. A node
+ * that exceeds a budget while its open is deferred is aborted, as with
+ * navigating away, and node types whose onNarrate exceeds its budget are
+ * narrated by the engine instead until resetHookViolations is called.
+ * Hooks are not interrupted; the budget is checked when they return.
+ *
+ * @param hook The hook to limit
+ * @param microseconds The time an invocation may take, or 0 for no limit
+ */
+void NaviEngine::setHookBudget(Hook hook, unsigned int microseconds)
+{
+    if (watchdog_ == NULL)
+        watchdog_ = new HookWatchdog();
+    watchdog_->setBudget(hook, microseconds);
+}
+
+/**
+ * Get the hook budget violations
+ *
+ * @return One entry per node type and hook that exceeded its budget
+ */
+std::vector<NaviEngine::HookViolation> NaviEngine::hookViolations() const
+{
+    std::vector<HookViolation> violations;
+    if (watchdog_ != NULL)
+        watchdog_->violations(violations);
+    return violations;
+}
+
+/**
+ * Clear the hook budget violations
+ *
+ * Node types narrated by the engine after exceeding the onNarrate budget
+ * narrate themselves again.
+ */
+void NaviEngine::resetHookViolations()
+{
+    if (watchdog_ != NULL)
+        watchdog_->reset();
+}
+
+/**
+ * Start timing a hook if any hook has a budget
+ *
+ * @param node The node whose hook is invoked
+ * @return The timing to pass to endHook
+ */
+HookTiming NaviEngine::startHook(const AnyNode* node) const
+{
+    if (preparer_ != NULL)
+        preparer_->wait(node);
+    if (watchdog_ == NULL)
+    {
+        HookTiming timing;
+        timing.type = NULL;
+        timing.start = 0;
+        return timing;
+    }
+    return watchdog_->start(node);
+}
+
+/**
+ * Check a hook against its budget and abort the deferred open of its node
+ * if it was exceeded
+ *
+ * @param hook The hook that was invoked
+ * @param node The node whose hook was invoked, it may have been deleted
+ * @param timing The timing returned by startHook
+ * @return true if a deferred open was aborted, otherwise false
+ */
+bool NaviEngine::endHook(Hook hook, const AnyNode* node, const HookTiming& timing)
+{
+    if (timing.type == NULL || not watchdog_->check(hook, timing))
+        return false;
+    if (node != pendingNode_)
+        return false;
+
+    abortOpen(NULL);
+    return true;
+}
+
+/**
+ * Check if a node is narrated by the engine instead of by its hooks
+ *
+ * @param node The node to narrate
+ * @return true if the node type exceeded the onNarrate budget, otherwise false
+ */
+bool NaviEngine::narrateFallback(const AnyNode* node) const
+{
+    return watchdog_ != NULL && watchdog_->fallback(node);
+}
+
+/**
+ * Narrate a state change unless a batch is in progress
+ *
+ * @param before The MenuState before
+ * @param after The MenuState after
+ */
+void NaviEngine::announceChange(const MenuState& before, const MenuState& after)
+{
+    if (batchDepth_ == 0)
+    {
+        TraceScope trace("narrateChange", after.state.currentNode, menuStack.size());
+        narrateChange(before, after);
+    }
+}
+
+/**
+ * Prepare the current choice and its neighbours in the background
+ *
+ * When enabled, AnyNode::prepare is invoked on a low priority thread for the
+ * current choice and its next and previous siblings after each command.
+ * Pending preparations are cancelled when the next command starts, see
+ * AnyNode::prepare for when the engine waits for a running one.
+ *
+ * @param enable If true, nodes are prepared, otherwise not
+ */
+void NaviEngine::setPrepareNeighbours(bool enable)
+{
+    if (enable && preparer_ == NULL)
+    {
+        preparer_ = new NodePreparer();
+        if (commandDepth_ == 0)
+            schedulePreparation();
+    }
+    else if (not enable && preparer_ != NULL)
+    {
+        delete preparer_;
+        preparer_ = NULL;
+    }
+}
+
+/**
+ * Called when a command starts
+ *
+ * Records the state to compare with when the command ends, cancels pending
+ * node preparations without waiting for a running one and switches to the
+ * latest published model version.
+ */
+void NaviEngine::beginCommand()
+{
+    if (commandDepth_++ > 0)
+        return;
+
+    startDelta();
+    if (preparer_ != NULL)
+        preparer_->cancel();
+    syncModel();
+
+    commandMenus_ = menuStack.size();
+    commandTrail_ = 0;
+    if (not menuStack.empty())
+    {
+        commandStart_ = menuStack.back();
+        commandTrail_ = trails_.back().size();
+    }
+}
+
+/**
+ * Called when a command ends
+ *
+ * Reports what changed to the renderer, evicts nodes if the memory budget
+ * is exceeded and prepares the nodes the user is likely to open next.
+ */
+void NaviEngine::endCommand()
+{
+    if (--commandDepth_ > 0)
+        return;
+
+    updateTrail();
+    checkPendingOpen();
+    logState();
+    if (batchDepth_ == 0)
+    {
+        recordHistory();
+        emitDelta();
+        if (budget_ != NULL)
+            evictNodes();
+    }
+    if (preparer_ != NULL)
+        schedulePreparation();
+}
+
+/**
+ * Schedule the current choice and its neighbours for preparation
+ */
+void NaviEngine::schedulePreparation()
+{
+    if (batchDepth_ > 0 || menuStack.empty())
+        return;
+
+    std::vector<AnyNode*> nodes;
+    AnyNode* choice = menuStack.back().state.currentChoice;
+    if (choice != NULL)
+    {
+        nodes.push_back(choice);
+        if (choice->next_ != NULL && choice->next_ != choice)
+            nodes.push_back(choice->next_);
+        if (choice->prev_ != NULL && choice->prev_ != choice && choice->prev_ != choice->next_)
+            nodes.push_back(choice->prev_);
+    }
+    preparer_->schedule(nodes);
+}
+
+/**
+ * Keep a history of visited nodes for back and forward
+ *
+ * A new entry is made whenever another node becomes the current node. Moving
+ * the choice updates the current entry, so back returns to the choice that
+ * was left. The oldest entries are dropped when the history is full.
+ *
+ * @param entries The number of entries to keep, or 0 to disable the history
+ */
+void NaviEngine::setHistorySize(size_t entries)
+{
+    historySize_ = entries;
+    while (history_.size() > historySize_)
+    {
+        history_.pop_front();
+        if (historyCursor_ > 0)
+            historyCursor_--;
+    }
+    if (historyCursor_ >= history_.size())
+        historyCursor_ = history_.empty() ? 0 : history_.size() - 1;
+}
+
+/**
+ * Go back to the previous entry in the history
+ *
+ * The node and choice are restored directly, only the restored node is
+ * opened. Entries whose nodes no longer exist are dropped.
+ *
+ * @return true on success, otherwise false
+ */
+bool NaviEngine::back()
+{
+    CommandScope scope(*this, "back");
+    logCommand(CommandLog::BACK);
+    size_t cursor = historyCursor_;
+    while (historyCursor_ > 0 && historyCursor_ < history_.size())
+    {
+        historyCursor_--;
+        if (restoreHistory(history_[historyCursor_]))
+            return good_;
+        if (history_[historyCursor_].menuModel == menuStack.back().menuModel)
+        {
+            history_.erase(history_.begin() + historyCursor_);
+            cursor--;
+        }
+    }
+    historyCursor_ = cursor;
+    return false;
+}
+
+/**
+ * Go forward to the next entry in the history
+ *
+ * Works as back, in the other direction.
+ *
+ * @return true on success, otherwise false
+ */
+bool NaviEngine::forward()
+{
+    CommandScope scope(*this, "forward");
+    logCommand(CommandLog::FORWARD);
+    size_t cursor = historyCursor_;
+    while (historyCursor_ + 1 < history_.size())
+    {
+        historyCursor_++;
+        if (restoreHistory(history_[historyCursor_]))
+            return good_;
+        if (history_[historyCursor_].menuModel == menuStack.back().menuModel)
+        {
+            history_.erase(history_.begin() + historyCursor_);
+            historyCursor_--;
+        }
+    }
+    historyCursor_ = cursor;
+    return false;
+}
+
+/**
+ * Record the current state in the history
+ */
+void NaviEngine::recordHistory()
+{
+    if (historySize_ == 0 || historyMoving_ || menuStack.empty())
+        return;
+
+    const MenuState& now = menuStack.back();
+    AnyNode* node = now.state.currentNode;
+    if (node == NULL)
+        return;
+
+    // The trail is the path from the model, a node outside of it is not recorded
+    const std::vector<selection_type>& trail = trails_.back();
+    if (trail.empty() ? node != now.menuModel : trail.back().currentChoice != node)
+        return;
+
+    if (not history_.empty())
+    {
+        HistoryEntry& entry = history_[historyCursor_];
+        if (entry.menuModel == now.menuModel && entry.state.currentNode == node)
+        {
+            if (entry.state.currentChoice != now.state.currentChoice
+                    || entry.state.currentChild != now.state.currentChild)
+            {
+                entry.state = now.state;
+                entry.choice = choiceIndex(now.state);
+            }
+            return;
+        }
+        history_.erase(history_.begin() + historyCursor_ + 1, history_.end());
+    }
+
+    HistoryEntry entry;
+    entry.menuModel = now.menuModel;
+    entry.state = now.state;
+    entry.choice = choiceIndex(now.state);
+    entry.trail = trail;
+    entry.path.resize(trail.size());
+    for (size_t i = 0; i < trail.size(); ++i)
+        entry.path[i] = trail[i].currentNode->indexOf(trail[i].currentChoice);
+
+    history_.push_back(entry);
+    if (history_.size() > historySize_)
+        history_.pop_front();
+    historyCursor_ = history_.size() - 1;
+}
+
+/**
+ * Get the index of the current choice among the children of the current node
+ *
+ * @param state The selection to get the index for
+ * @return The index of the choice, or -1 if there is no choice or the node is virtual
+ */
+int NaviEngine::choiceIndex(const selection_type& state)
+{
+    AnyNode* node = state.currentNode;
+    if (state.currentChoice == NULL || node->isVirtual())
+        return -1;
+
+    int position = node->currentPosition(*this);
+    if (position > 0)
+        return position - 1;
+    return node->indexOf(state.currentChoice);
+}
+
+/**
+ * Restore a history entry if its nodes still exist
+ *
+ * The entry is checked from the model of the current menu by the recorded
+ * child indices. The recorded nodes are only compared, never dereferenced,
+ * until they have been found again this way.
+ *
+ * @param entry The entry to restore
+ * @return true if the entry was restored, otherwise false
+ */
+bool NaviEngine::restoreHistory(const HistoryEntry& entry)
+{
+    MenuState& menu = menuStack.back();
+    if (entry.menuModel != menu.menuModel)
+        return false;
+
+    AnyNode* node = menu.menuModel;
+    for (size_t i = 0; i < entry.path.size(); ++i)
+    {
+        AnyNode* child = node->childAt(entry.path[i]);
+        if (child == NULL || child != entry.trail[i].currentChoice)
+            return false;
+        node = child;
+    }
+    if (node != entry.state.currentNode)
+        return false;
+
+    if (node->isVirtual())
+    {
+        if (entry.state.currentChild >= node->numberOfChildren())
+            return false;
+    }
+    else if (entry.state.currentChoice != NULL && node->childAt(entry.choice) != entry.state.currentChoice)
+    {
+        return false;
+    }
+
+    MenuState before = menu;
+    menu.state = entry.state;
+    trails_.back() = entry.trail;
+
+    historyMoving_ = true;
+    if (stateHasChanged(before))
+    {
+        openOnChange(before);
+    }
+    else
+    {
+        good_ = true;
+        announceChange(before, menu);
+    }
+    historyMoving_ = false;
+    return true;
+}
+
+/**
+ * Drop the history entries of a model that is about to be deleted
+ *
+ * @param model The model of the menu being closed
+ */
+void NaviEngine::forgetHistory(const AnyNode* model)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < history_.size(); ++i)
+    {
+        if (history_[i].menuModel == model)
+        {
+            if (i <= historyCursor_ && historyCursor_ > 0)
+                historyCursor_--;
+            continue;
+        }
+        history_[kept++] = history_[i];
+    }
+    history_.resize(kept);
+    if (historyCursor_ >= history_.size())
+        historyCursor_ = history_.empty() ? 0 : history_.size() - 1;
+}
+
+/**
+ * Limit the memory held by opened nodes
+ *
+ * Nodes are measured when they are opened. When the total exceeds the limit
+ * at the end of a command, after the change has been narrated and rendered,
+ * or at the commit of a batch, AnyNode::evict is invoked on the least
+ * recently opened nodes which are not on the path to the current node of
+ * any open menu. Nodes only release
+ * memory if they implement evict, e.g. MenuNode and VirtualMenuNode made
+ * evictable with setEvictable, so nodes that build their children in onOpen
+ * must opt in.
+ *
+ * @param bytes The approximate number of bytes opened nodes may hold, or 0 for no limit
+ */
+void NaviEngine::setMemoryBudget(size_t bytes)
+{
+    if (bytes == 0)
+    {
+        delete budget_;
+        budget_ = NULL;
+    }
+    else if (budget_ == NULL)
+    {
+        budget_ = new MemoryBudget(bytes);
+    }
+    else
+    {
+        budget_->setLimit(bytes);
+        evictNodes();
+    }
+}
+
+/**
+ * Get the memory held by opened nodes
+ *
+ * @return The approximate number of bytes held by opened nodes, or 0 if no budget is set
+ */
+size_t NaviEngine::memoryInUse() const
+{
+    if (budget_ == NULL)
+        return 0;
+    return budget_->used();
+}
+
+/**
+ * Account for an opened node
+ *
+ * Nodes are evicted when the outermost command ends, after the change has
+ * been narrated and rendered, or right away outside of a command.
+ *
+ * @param node The node that was opened
+ */
+void NaviEngine::accountOpened(AnyNode* node)
+{
+    if (budget_ == NULL || not menuStack.back().ownsModel)
+        return;
+
+    budget_->touch(node);
+    if (commandDepth_ == 0)
+        evictNodes();
+}
+
+/**
+ * Evict nodes until the memory budget is no longer exceeded
+ *
+ * The paths to the current nodes of all menus are kept, and so are the
+ * states a running command, batch or render delta is compared with.
+ */
+void NaviEngine::evictNodes()
+{
+    if (budget_->used() <= budget_->limit())
+        return;
+
+    std::set<const AnyNode*> path;
+    for (size_t i = 0; i < menuStack.size(); ++i)
+    {
+        keepPath(path, menuStack[i].state.currentNode);
+        path.insert(menuStack[i].menuModel);
+
+        // Nodes the menu was navigated through, e.g. views, are on the path too
+        const std::vector<selection_type>& trail = trails_[i];
+        for (size_t j = 0; j < trail.size(); ++j)
+            keepPath(path, trail[j].currentNode);
+    }
+    if (commandDepth_ > 0)
+        keepPath(path, commandStart_.state.currentNode);
+    if (batchDepth_ > 0)
+        keepPath(path, batchBefore_.state.currentNode);
+    if (deltaPending_)
+    {
+        keepPath(path, deltaStart_.state.currentNode);
+        for (size_t i = 0; i < dirtyNodes_.size(); ++i)
+            keepPath(path, dirtyNodes_[i].first);
+    }
+    // A loading node off the path may be deleted by the eviction, abort it first
+    if (pendingNode_ != NULL && path.count(pendingNode_) == 0)
+        abortOpen(NULL);
+    budget_->evict(path);
+}
+
+/**
+ * Switch to the latest version of a published model
+ *
+ * Every menu navigating the old version is mapped to the new one, see
+ * syncMenu, and so are the state and the nodes the next render delta is
+ * compared with. Nothing is switched inside a batch.
+ */
+void NaviEngine::syncModel()
+{
+    if (publisher_ == NULL || batchDepth_ > 0 || publisher_->version() == version_->number)
+        return;
+
+    ModelVersion* old = version_;
+    version_ = publisher_->acquire();
+
+    for (size_t i = 0; i < menuStack.size(); ++i)
+    {
+        AnyNode* model = menuStack[i].menuModel;
+        if (syncMenu(menuStack[i], &trails_[i], old->root))
+        {
+            abortOpen(model);
+            forgetHistory(model);
+        }
+    }
+
+    // The renderer is told that the model was replaced, the model is only compared
+    if (deltaPending_ && syncMenu(deltaStart_, NULL, old->root))
+        deltaStart_.menuModel = NULL;
+    for (size_t i = 0; i < dirtyNodes_.size(); ++i)
+    {
+        bool found;
+        AnyNode* node = nodeInVersion(dirtyNodes_[i].first, old->root, version_->root, found);
+        if (node != NULL)
+            dirtyNodes_[i].first = node;
+    }
+
+    publisher_->release(old);
+}
+
+/**
+ * Map a menu navigating an old version of a published model to the latest one
+ *
+ * The model, the nodes of the trail, the current node and choice and the
+ * current virtual child are looked up by uri. If a node no longer exists,
+ * its closest remaining ancestor becomes the current node.
+ *
+ * @param menu The menu to map
+ * @param trail The trail of the menu, or NULL if it has none
+ * @param oldRoot The root of the old version
+ * @return true if the menu navigated the old version, otherwise false
+ */
+bool NaviEngine::syncMenu(MenuState& menu, std::vector<selection_type>* trail, const AnyNode* oldRoot)
+{
+    bool found;
+    AnyNode* model = nodeInVersion(menu.menuModel, oldRoot, version_->root, found);
+    if (model == NULL)
+        return false;
+
+    std::vector<const std::string*> path;
+    if (not found)
+    {
+        // The state lies below a node that no longer exists
+    }
+    else if (trail != NULL && not trail->empty())
+    {
+        // The navigation path also leads through shared subtrees
+        for (size_t i = trail->size(); i > 0; --i)
+            path.push_back(&(*trail)[i - 1].currentChoice->uri_);
+    }
+    else
+    {
+        for (AnyNode* node = menu.state.currentNode; node != NULL && node != menu.menuModel; node = node->parent_)
+            path.push_back(&node->uri_);
+    }
+
+    AnyNode* node = model;
+    if (trail != NULL)
+        trail->clear();
+    while (found && not path.empty())
+    {
+        AnyNode* child = childByUri(node, *path.back());
+        path.pop_back();
+        if (child != NULL)
+        {
+            if (trail != NULL)
+            {
+                selection_type step;
+                step.currentNode = node;
+                step.currentChoice = child;
+                step.currentChild = 0;
+                trail->push_back(step);
+            }
+            node = child;
+        }
+        else
+            found = false;
+    }
+
+    AnyNode* choice = NULL;
+    int index = found ? menu.state.currentChild : 0;
+    if (found && menu.state.currentNode != NULL)
     {
-        if (not menu.state.currentNode->narrateName())
-            narrate(menu.state.currentNode->name_.c_str());
-        narrateShortPause();
-        narrateNode(menu.state.currentChoice);
+        if (menu.state.currentNode->isVirtual())
+            index = std::max(positionOfUri(node, menu.state.currentNode->childUri(menu.state.currentChild)), 0);
+        else if (menu.state.currentChoice != NULL)
+            choice = childByUri(node, menu.state.currentChoice->uri_);
     }
+    if (choice == NULL)
+        choice = node->firstChild();
+
+    menu.menuModel = model;
+    menu.state.currentNode = node;
+    menu.state.currentChoice = choice;
+    menu.state.currentChild = index;
+    return true;
 }
 
 /**
- * Invoke onNarrate for a node
+ * Report a change the engine can not detect by itself
  *
- * If onNarrate returns false NaviEngine will render the node
- * with the help of it's virtual narrate functions and the nodes narrate methods
+ * Nodes call this when they insert or remove children or update a name or
+ * info, so renderers can repaint them. The change is reported with the
+ * current command, or with the next one if no command is running.
  *
- * @param choice A pointer the to choice to narrate
+ * @param node The node that changed
+ * @param changes RenderChange flags, CHILDREN_CHANGED or CONTENT_CHANGED
  */
-void NaviEngine::narrateNode(AnyNode* node)
+void NaviEngine::markDirty(AnyNode* node, int changes)
 {
-    if (node == 0)
+    if (node == NULL || changes == 0)
         return;
 
-    if (not node->onNarrate())
+    startDelta();
+    for (size_t i = 0; i < dirtyNodes_.size(); ++i)
     {
-        if (not node->narrateName())
+        if (dirtyNodes_[i].first == node)
         {
-            narrate(currentSibling(node));
-            narrate(node->name_.c_str());
-            narrateLongPause();
+            dirtyNodes_[i].second |= changes;
+            return;
         }
     }
+    dirtyNodes_.push_back(std::make_pair(node, changes));
 }
 
 /**
- * Invoke onRender for a node
+ * Default renderChange, renders nothing
  *
- * @param node A pointer the the node to render
- * @return The result from the onRender invoke
+ * @param delta The changes made by the command
  */
-bool NaviEngine::renderNode(AnyNode* node)
+void NaviEngine::renderChange(const RenderDelta& /* delta */)
 {
-    if (node == NULL)
-        return false;
+}
 
-    bool selfRendered = node->onRender();
-    return not selfRendered;
+/**
+ * Record the state the next render delta is compared with, unless already recorded
+ */
+void NaviEngine::startDelta()
+{
+    if (deltaPending_)
+        return;
+
+    deltaPending_ = true;
+    deltaMenus_ = menuStack.size();
+    if (menuStack.empty())
+        deltaStart_ = MenuState();
+    else
+        deltaStart_ = menuStack.back();
 }
 
 /**
- * Go to the root (top) node
+ * Compare the state with the recorded one and report the changes to the renderer
+ */
+void NaviEngine::emitDelta()
+{
+    if (not deltaPending_)
+        return;
+    deltaPending_ = false;
+
+    MenuState now;
+    if (not menuStack.empty())
+        now = menuStack.back();
+
+    RenderDelta delta;
+    delta.changes = 0;
+    delta.before = deltaStart_.state;
+    delta.after = now.state;
+    delta.nodes.swap(dirtyNodes_);
+
+    if (menuStack.size() != deltaMenus_ || now.menuModel != deltaStart_.menuModel)
+        delta.changes |= MENU_CHANGED;
+    if (now.state.currentNode != deltaStart_.state.currentNode)
+        delta.changes |= NODE_OPENED;
+    if (now.state.currentChoice != deltaStart_.state.currentChoice
+            || now.state.currentChild != deltaStart_.state.currentChild)
+        delta.changes |= CHOICE_MOVED;
+    for (size_t i = 0; i < delta.nodes.size(); ++i)
+        delta.changes |= delta.nodes[i].second;
+
+    if (delta.changes != 0)
+        renderChange(delta);
+}
+
+/**
+ * Update the trail of the current menu after a command
  *
- * @return true on success, otherwise false
+ * The trail holds the selections the current node was reached through, so
+ * up can return to a node other than the parent, e.g. a view.
  */
-bool NaviEngine::top()
+void NaviEngine::updateTrail()
 {
-    MenuState menu = menuStack.top();
+    if (menuStack.empty() || menuStack.size() != commandMenus_)
+        return;
+
+    std::vector<selection_type>& trail = trails_.back();
+    const MenuState& now = menuStack.back();
+    AnyNode* node = now.state.currentNode;
 
-    // If already on top level, open the menu
-    if (menu.state.currentNode == menu.menuModel)
+    if (node == commandStart_.state.currentNode && now.menuModel == commandStart_.menuModel)
     {
-        menuStack.top().state.currentNode->beforeOnOpen();
-        narrateShortPause();
-        menuStack.top().state.currentNode->onOpen(*this);
+        // Drop steps recorded by a path that was rolled back
+        if (trail.size() > commandTrail_)
+            trail.resize(commandTrail_);
+        return;
     }
 
-    openOnChange_ = false;
-    // If not on top level, go to top level
-    while (menuStack.size() > 1 || menu.state.currentNode != menu.menuModel)
+    // Steps recorded while descending a path are already in place
+    if (trail.empty() ? node == now.menuModel : trail.back().currentChoice == node)
+        return;
+
+    if (trail.size() > commandTrail_)
+        trail.resize(commandTrail_);
+
+    if (node != NULL && node == commandStart_.state.currentChoice)
+        trail.push_back(commandStart_.state);
+    else if (not trail.empty() && trail.back().currentNode == node)
+        trail.pop_back();
+    else
+        rebuildTrail(trail, now);
+}
+
+/**
+ * Rebuild a trail from the parents of the current node
+ *
+ * The parents are followed up to the model, or up to a node the trail
+ * already passes through or shows as a child, whose steps are kept. That way
+ * a node in a subtree shared through a MenuLinkNode, whose parent is the
+ * target rather than the link, still returns through the link.
+ *
+ * @param trail The trail to rebuild, holding the trail from before
+ * @param menu The state of the menu the trail belongs to
+ */
+void NaviEngine::rebuildTrail(std::vector<selection_type>& trail, const MenuState& menu)
+{
+    std::vector<selection_type> steps;
+    size_t kept = 0;
+    AnyNode* node = menu.state.currentNode;
+    for (; node != NULL && node != menu.menuModel; node = node->parent_)
     {
-        narrateStop();
-        up();
-        menu = menuStack.top();
-    }
-    openOnChange_ = true;
+        selection_type selection;
+        selection.currentNode = node->parent_;
+        selection.currentChoice = node;
+        selection.currentChild = 0;
 
-    // We are now on top level, open the menu
-    menuStack.top().state.currentNode->beforeOnOpen();
-    narrateShortPause();
-    menuStack.top().state.currentNode->onOpen(*this);
+        for (kept = trail.size(); kept > 0; --kept)
+        {
+            AnyNode* passed = trail[kept - 1].currentChoice;
+            if (passed == node)
+                break;
+            if (passed->indexOf(node) >= 0)
+            {
+                selection.currentNode = passed;
+                steps.push_back(selection);
+                break;
+            }
+        }
+        if (kept > 0)
+            break;
+        steps.push_back(selection);
+    }
 
-    return true;
+    // A node outside the model that the trail does not pass through has no trail
+    trail.resize(kept);
+    if (node != NULL)
+        trail.insert(trail.end(), steps.rbegin(), steps.rend());
 }
 
 /**
@@ -226,7 +1714,7 @@ bool NaviEngine::top()
  */
 bool NaviEngine::stateHasChanged(const MenuState& before)
 {
-    MenuState& now = menuStack.top();
+    MenuState& now = menuStack.back();
 
     if (now.state.currentNode != before.state.currentNode)
     {
@@ -243,21 +1731,14 @@ bool NaviEngine::stateHasChanged(const MenuState& before)
  */
 bool NaviEngine::openOnChange(const MenuState& before)
 {
-    MenuState& now = menuStack.top();
-    if (now.state.currentNode == NULL)
+    // closeMenu may pop the menu, so look up the state again afterwards
+    if (menuStack.back().state.currentNode == NULL)
         closeMenu();
 
-    // if openOnChange_ is false we do not want to open nodes when state changes
-    if (not openOnChange_)
-        return true;
-
     if (stateHasChanged(before))
     {
-        now = menuStack.top();
-        now.state.currentNode->beforeOnOpen();
-        narrateShortPause();
-        good_ = now.state.currentNode->onOpen(*this);
-        narrateChange(before, now);
+        good_ = openNode(menuStack.back().state.currentNode);
+        announceChange(before, menuStack.back());
         return good_;
     }
     return false;
@@ -266,13 +1747,29 @@ bool NaviEngine::openOnChange(const MenuState& before)
 /**
  * Go to the parent node
  *
+ * A node reached through another node than its parent, e.g. a child of a
+ * MenuViewNode or a MenuLinkNode, returns to the node it was reached
+ * through, as kept in the trail of the menu.
+ *
  * @return true on success, otherwise false
  */
 bool NaviEngine::up()
 {
-    bool success = false;
-    MenuState before = menuStack.top();
-    success = menuStack.top().state.currentNode->up(*this);
+    CommandScope scope(*this, "up");
+    logCommand(CommandLog::UP);
+    MenuState before = menuStack.back();
+    menuStack.back().state.currentNode->up(*this);
+
+    // A node reached through another node than its parent, e.g. a view,
+    // goes back to the selection it was reached from
+    std::vector<selection_type>& trail = trails_.back();
+    MenuState& now = menuStack.back();
+    if (not trail.empty() && now.state.currentNode != NULL
+            && now.state.currentNode == before.state.currentNode->parent_
+            && trail.back().currentChoice == before.state.currentNode)
+    {
+        now.state = trail.back();
+    }
 
     return openOnChange(before);
 }
@@ -284,9 +1781,11 @@ bool NaviEngine::up()
  */
 bool NaviEngine::select()
 {
+    CommandScope scope(*this, "select");
+    logCommand(CommandLog::SELECT);
     bool success = false;
-    MenuState before = menuStack.top();
-    success = menuStack.top().state.currentNode->select(*this);
+    MenuState before = menuStack.back();
+    success = menuStack.back().state.currentNode->select(*this);
 
     return openOnChange(before);
 }
@@ -294,18 +1793,25 @@ bool NaviEngine::select()
 /**
  * Open the child referenced by uri
  *
+ * If the current node has no such child and a uri index is set, the node is
+ * looked up in the index and opened as by selectPath from the root.
+ *
  * @param uri The uri of the child
  * @return true on success, otherwise false
  */
 bool NaviEngine::selectNodeByUri(std::string uri)
 {
+    CommandScope scope(*this, "selectNodeByUri");
+    logCommand(CommandLog::SELECT_URI, 0, uri);
     bool success = false;
-    MenuState before = menuStack.top();
-    AnyNode* currentNode = menuStack.top().state.currentNode;
+    MenuState before = menuStack.back();
+    AnyNode* currentNode = menuStack.back().state.currentNode;
 
     if (currentNode->isVirtual())
     {
         success = currentNode->selectByUri(*this, uri);
+        if (success && menuStack.back().state.currentChild != before.state.currentChild)
+            announceChange(before, menuStack.back());
     }
     else
     {
@@ -316,7 +1822,7 @@ bool NaviEngine::selectNodeByUri(std::string uri)
             {
                 if (uri == currentChild->uri_)
                 {
-                    menuStack.top().state.currentChoice = currentChild;
+                    menuStack.back().state.currentChoice = currentChild;
                     success = currentNode->select(*this);
                     break;
                 }
@@ -325,11 +1831,287 @@ bool NaviEngine::selectNodeByUri(std::string uri)
         }
     }
 
+    if (stateHasChanged(before))
+        return openOnChange(before);
+    if (not success && uriIndex_ != NULL && menuStack.size() == 1)
+        return selectIndexedUri(uri, before);
+    return success;
+}
+
+/**
+ * Open the child with an id
+ *
+ * Works as selectNodeByUri, but compares ids instead of uris.
+ *
+ * @param id The id of the child
+ * @return true on success, otherwise false
+ */
+bool NaviEngine::selectNodeById(uint64_t id)
+{
+    CommandScope scope(*this, "selectNodeById");
+    logCommand(CommandLog::SELECT_ID, id);
+    bool success = false;
+    MenuState before = menuStack.back();
+    AnyNode* currentNode = menuStack.back().state.currentNode;
+
+    if (currentNode->isVirtual())
+    {
+        success = currentNode->selectById(*this, id);
+        if (success && menuStack.back().state.currentChild != before.state.currentChild)
+            announceChange(before, menuStack.back());
+    }
+    else
+    {
+        AnyNode* first = currentNode->firstChild();
+        for (AnyNode* child = first; child != NULL;)
+        {
+            if (child->id_ == id)
+            {
+                menuStack.back().state.currentChoice = child;
+                success = currentNode->select(*this);
+                break;
+            }
+            child = child->next_;
+            if (child == first)
+                child = NULL;
+        }
+    }
+
     if (stateHasChanged(before))
         return openOnChange(before);
     return success;
 }
 
+/**
+ * Get the id of the choice of a menu state
+ *
+ * For a virtual node this is the id of the current virtual child. Comparing
+ * the ids of two states tells if the same child is chosen, also after the
+ * virtual children have been moved in memory.
+ *
+ * @param state The menu state
+ * @return The id of the choice, or 0 if there is none
+ */
+uint64_t NaviEngine::choiceId(const MenuState& state)
+{
+    AnyNode* node = state.state.currentNode;
+    if (node != NULL && node->isVirtual())
+        return node->childId(state.state.currentChild);
+    return (state.state.currentChoice != NULL) ? state.state.currentChoice->id_ : 0;
+}
+
+/**
+ * Use a persistent index to find nodes by uri anywhere in the model
+ *
+ * The index is used by selectNodeByUri for the model of the first menu,
+ * while no other menu is open. It is not owned by the engine.
+ *
+ * @param index An open index of the model, or NULL for none
+ */
+void NaviEngine::setUriIndex(const UriIndex* index)
+{
+    uriIndex_ = index;
+}
+
+/**
+ * Open the node of a uri found in the uri index
+ *
+ * @param uri The uri of the node
+ * @param before The MenuState before selectNodeByUri was called
+ * @return true on success, otherwise false
+ */
+bool NaviEngine::selectIndexedUri(const std::string& uri, const MenuState& before)
+{
+    std::vector<int> locator;
+    if (not uriIndex_->lookup(uri, locator) || locator.empty())
+        return false;
+
+    PathStart path;
+    startPath(path, before);
+    MenuState& menu = menuStack.back();
+    menu.state.currentNode = menu.menuModel;
+    menu.state.currentChoice = menu.menuModel->firstChild();
+    menu.state.currentChild = 0;
+    trails_.back().clear();
+
+    bool success = true;
+    for (size_t i = 0; success && i < locator.size(); ++i)
+    {
+        AnyNode* child = menuStack.back().state.currentNode->childAt(locator[i]);
+        menuStack.back().state.currentChild = locator[i];
+        success = descendInto(child, i + 1 == locator.size(), path);
+    }
+
+    return finishPath(path, success);
+}
+
+/**
+ * Open the node at the end of a path of uris
+ *
+ * Each uri selects a child of the node selected by the previous one, starting
+ * from the current node. Intermediate nodes are only opened when they have no
+ * children yet, so they can build them, and nothing is narrated until the
+ * final node has been opened. On failure the state before the call is restored.
+ *
+ * @param uris The uris of the nodes along the path
+ * @return true on success, otherwise false
+ */
+bool NaviEngine::selectPath(const std::vector<std::string>& uris)
+{
+    CommandScope scope(*this, "selectPath");
+    if (logCommand(CommandLog::SELECT_PATH))
+        commandLog_->addPath(uris);
+    PathStart path;
+    startPath(path, menuStack.back());
+    bool success = not uris.empty();
+
+    for (size_t i = 0; success && i < uris.size(); ++i)
+    {
+        bool last = (i + 1 == uris.size());
+        AnyNode* currentNode = menuStack.back().state.currentNode;
+
+        // Virtual children are not nodes, so they can only end the path
+        if (currentNode->isVirtual())
+        {
+            success = last && currentNode->selectByUri(*this, uris[i]);
+            break;
+        }
+
+        success = descendInto(childByUri(currentNode, uris[i]), last, path);
+    }
+
+    return finishPath(path, success);
+}
+
+/**
+ * Open the node at the end of a path of child indices
+ *
+ * Works as selectPath with uris, but each step is given as the zero based
+ * index of the child to select. Virtual nodes can not be part of the path.
+ *
+ * @param indices The child indices of the nodes along the path
+ * @return true on success, otherwise false
+ */
+bool NaviEngine::selectPath(const std::vector<int>& indices)
+{
+    CommandScope scope(*this, "selectPath");
+    if (logCommand(CommandLog::SELECT_INDICES))
+        commandLog_->addPath(indices);
+    PathStart path;
+    startPath(path, menuStack.back());
+    bool success = not indices.empty();
+
+    for (size_t i = 0; success && i < indices.size(); ++i)
+    {
+        bool last = (i + 1 == indices.size());
+        AnyNode* currentNode = menuStack.back().state.currentNode;
+
+        AnyNode* child = currentNode->childAt(indices[i]);
+        menuStack.back().state.currentChild = indices[i];
+        success = descendInto(child, last, path);
+    }
+
+    return finishPath(path, success);
+}
+
+/**
+ * Record what to restore if selecting a path fails
+ *
+ * @param path The record to fill in
+ * @param before The MenuState before the path is selected
+ */
+void NaviEngine::startPath(PathStart& path, const MenuState& before)
+{
+    path.before = before;
+    path.depth = menuStack.size();
+    path.trail = trails_.back();
+}
+
+/**
+ * Select a child of the current node as one step of a path
+ *
+ * Only the select hook of the current node is invoked. An intermediate node
+ * without children is opened silently to let it build its children.
+ *
+ * @param child The child to select
+ * @param last If true, the child is the final node of the path
+ * @param path The record of the path, intermediate nodes opened are added to it
+ * @return true on success, otherwise false
+ */
+bool NaviEngine::descendInto(AnyNode* child, bool last, PathStart& path)
+{
+    if (child == NULL)
+        return false;
+
+    MenuState& menu = menuStack.back();
+    AnyNode* parent = menu.state.currentNode;
+    menu.state.currentChoice = child;
+    selection_type step = menu.state;
+    if (not parent->select(*this) || menuStack.back().state.currentNode != child)
+        return false;
+    trails_.back().push_back(step);
+
+    if (not last && child->firstChild() == NULL && not child->isVirtual())
+    {
+        HookTiming timing = startHook(child);
+        {
+            TraceScope trace("beforeOnOpen", child, menuStack.size());
+            child->beforeOnOpen();
+        }
+        bool opened;
+        {
+            TraceScope trace("onOpen", child, menuStack.size());
+            opened = child->onOpen(*this);
+        }
+        if (endHook(HOOK_OPEN, child, timing))
+            opened = false;
+        path.opened.push_back(child);
+        accountOpened(child);
+        return opened;
+    }
+    return true;
+}
+
+/**
+ * Open and narrate the final node of a path, or restore the state on failure
+ *
+ * On failure menus opened along the path are closed, the state and trail of
+ * the menu are restored and onClose is invoked on the intermediate nodes
+ * that were opened, last opened first, all without narrating.
+ *
+ * @param path The record of the path
+ * @param success The result of selecting the path
+ * @return true on success, otherwise false
+ */
+bool NaviEngine::finishPath(PathStart& path, bool success)
+{
+    if (success)
+    {
+        if (stateHasChanged(path.before))
+            return openOnChange(path.before);
+        return true;
+    }
+
+    while (menuStack.size() > path.depth)
+    {
+        MenuState menu = menuStack.back();
+        menuStack.pop_back();
+        trails_.pop_back();
+        releaseModel(menu.menuModel, menu.ownsModel);
+    }
+    if (menuStack.size() == path.depth)
+    {
+        menuStack.back() = path.before;
+        trails_.back() = path.trail;
+    }
+    for (size_t i = path.opened.size(); i > 0; --i)
+    {
+        TraceScope trace("onClose", path.opened[i - 1], menuStack.size());
+        path.opened[i - 1]->onClose(*this);
+    }
+    return false;
+}
+
 /**
  * Go to the next child and set it as the currently selected child
  *
@@ -337,11 +2119,13 @@ bool NaviEngine::selectNodeByUri(std::string uri)
  */
 bool NaviEngine::next()
 {
-    MenuState& menu = menuStack.top();
+    CommandScope scope(*this, "next");
+    logCommand(CommandLog::NEXT);
+    MenuState& menu = menuStack.back();
     MenuState before = menu;
     if (menu.state.currentNode->next(*this))
     {
-        narrateChange(before, menu);
+        announceChange(before, menu);
         return true;
     }
     return false;
@@ -354,11 +2138,13 @@ bool NaviEngine::next()
  */
 bool NaviEngine::prev()
 {
-    MenuState& menu = menuStack.top();
+    CommandScope scope(*this, "prev");
+    logCommand(CommandLog::PREV);
+    MenuState& menu = menuStack.back();
     MenuState before = menu;
     if (menu.state.currentNode->prev(*this))
     {
-        narrateChange(before, menu);
+        announceChange(before, menu);
         return true;
     }
     return false;
@@ -371,31 +2157,71 @@ bool NaviEngine::prev()
  */
 bool NaviEngine::openContextMenu()
 {
-    MenuState& menu = menuStack.top();
+    CommandScope scope(*this, "openContextMenu");
+    logCommand(CommandLog::OPEN_CONTEXT_MENU);
+    MenuState& menu = menuStack.back();
     return menu.state.currentNode->menu(*this);
 }
 
 /**
  * Let the current node process the command
  *
+ * A command log records that the data object has an unknown size, use the
+ * overload with a size to record its size.
+ *
  * @param command The enumerated command the node shall process
  * @data data A pointer to a optional data object
  * @return The result of the process operation
  */
 bool NaviEngine::process(int command, void* data)
 {
-    MenuState& menu = menuStack.top();
+    return processCommand(command, data, -1);
+}
+
+/**
+ * Let the current node process the command
+ *
+ * Works as process without a size, but a command log records the size of
+ * the data object, so a ReplaySource can supply one of the same size.
+ *
+ * @param command The enumerated command the node shall process
+ * @data data A pointer to a optional data object
+ * @param size The size of the data object in bytes
+ * @return The result of the process operation
+ */
+bool NaviEngine::process(int command, void* data, size_t size)
+{
+    return processCommand(command, data, size);
+}
+
+/**
+ * Let the current node process the command and record the size of its data
+ *
+ * @param command The enumerated command the node shall process
+ * @data data A pointer to a optional data object
+ * @param size The size of the data object in bytes, or -1 if it is not known
+ * @return The result of the process operation
+ */
+bool NaviEngine::processCommand(int command, void* data, int64_t size)
+{
+    CommandScope scope(*this, "process");
+    if (logCommand(CommandLog::PROCESS, command))
+        commandLog_->addPayload(data, size);
+    MenuState& menu = menuStack.back();
     MenuState before = menu;
 
     bool processedCommand = true;
 
-    if (not menu.state.currentNode->process(*this, command, data))
+    AnyNode* node = menu.state.currentNode;
+    HookTiming timing = startHook(node);
+    if (not node->process(*this, command, data))
     { // This is a short of time hack.
         processedCommand = false;
     }
+    endHook(HOOK_PROCESS, node, timing);
 
     { // Check if the node has changed during process
-        MenuState& menu = menuStack.top();
+        MenuState& menu = menuStack.back();
 
         if (menu.state.currentNode != before.state.currentNode)
         {
@@ -404,18 +2230,16 @@ bool NaviEngine::process(int command, void* data)
                 closeMenu();
             }
 
-            MenuState& menu = menuStack.top();
-            menu.state.currentNode->beforeOnOpen();
-            narrateShortPause();
-            good_ = menu.state.currentNode->onOpen(*this);
+            MenuState& menu = menuStack.back();
+            good_ = openNode(menu.state.currentNode);
             // Consider a successful node change to mean that the command was processed.
             if (good_)
                 processedCommand = true;
         }
     }
 
-    MenuState& after = menuStack.top();
-    narrateChange(before, after);
+    MenuState& after = menuStack.back();
+    announceChange(before, after);
 
     return processedCommand;
 }
@@ -428,20 +2252,71 @@ bool NaviEngine::process(int command, void* data)
  */
 int NaviEngine::numberOfChildren(AnyNode* node)
 {
-    if (node == NULL || node->firstChild() == NULL)
+    if (node == NULL || node->isVirtual())
     {
         return 0;
     }
 
-    const AnyNode* tmp = node->firstChild();
-    int num = 0;
-    do
+    return node->numberOfChildren();
+}
+
+/**
+ * Get the children of the current node around the current choice
+ *
+ * The window holds up to before + after + 1 children. Near the ends of the
+ * list it is moved so it stays full. Virtual children have no node and are
+ * given by their index only. For MenuNode, VirtualMenuNode and MenuViewNode
+ * the cost does not depend on the number of children.
+ *
+ * @param before The number of children to include before the current choice
+ * @param after The number of children to include after the current choice
+ * @return The children in the window, their positions and the total count
+ */
+NaviEngine::Window NaviEngine::visibleWindow(int before, int after)
+{
+    Window window;
+    window.total = 0;
+    window.current = -1;
+
+    AnyNode* node = menuStack.empty() ? NULL : menuStack.back().state.currentNode;
+    if (node == NULL)
+        return window;
+
+    const selection_type& state = menuStack.back().state;
+    window.total = node->numberOfChildren();
+    if (window.total == 0)
+        return window;
+
+    if (node->isVirtual())
+        window.current = state.currentChild;
+    else if (node->currentPosition(*this) > 0)
+        window.current = node->currentPosition(*this) - 1;
+    else if (state.currentChoice != NULL)
+        window.current = node->indexOf(state.currentChoice);
+
+    int current = (window.current >= 0 && window.current < window.total) ? window.current : 0;
+    int size = std::min(window.total, std::max(before, 0) + std::max(after, 0) + 1);
+    int first = std::max(current - std::max(before, 0), 0);
+    first = std::min(first, window.total - size);
+
+    window.entries.resize(size);
+    for (int i = 0; i < size; ++i)
     {
-        tmp = tmp->next_;
-        num++;
-    } while (tmp != node->firstChild() && tmp != NULL);
+        WindowEntry& entry = window.entries[i];
+        entry.index = first + i;
+        entry.node = node->isVirtual() ? NULL : node->childAt(entry.index);
+    }
+    return window;
+}
 
-    return num;
+/**
+ * Get the number of open menus
+ *
+ * @return The number of menus on the menu stack
+ */
+int NaviEngine::numberOfMenus() const
+{
+    return menuStack.size();
 }
 
 /**
@@ -451,17 +2326,22 @@ int NaviEngine::numberOfChildren(AnyNode* node)
  */
 AnyNode* NaviEngine::getCurrentNode()
 {
-    return menuStack.top().state.currentNode;
+    return menuStack.back().state.currentNode;
 }
 
 /**
  * Set the current node
  *
+ * The current virtual child is reset when the current node changes.
+ *
  * @param node A pointer to the node which shell become the current node
  */
 void NaviEngine::setCurrentNode(AnyNode* node)
 {
-    menuStack.top().state.currentNode = node;
+    selection_type& state = menuStack.back().state;
+    if (state.currentNode != node)
+        state.currentChild = 0;
+    state.currentNode = node;
 }
 
 /**
@@ -471,7 +2351,7 @@ void NaviEngine::setCurrentNode(AnyNode* node)
  */
 AnyNode* NaviEngine::getCurrentChoice()
 {
-    return menuStack.top().state.currentChoice;
+    return menuStack.back().state.currentChoice;
 }
 
 /**
@@ -481,5 +2361,25 @@ AnyNode* NaviEngine::getCurrentChoice()
  */
 void NaviEngine::setCurrentChoice(AnyNode* node)
 {
-    menuStack.top().state.currentChoice = node;
+    menuStack.back().state.currentChoice = node;
+}
+
+/**
+ * Get the current child of a virtual node
+ *
+ * @return The index of the current virtual child
+ */
+int NaviEngine::getCurrentChild()
+{
+    return menuStack.back().state.currentChild;
+}
+
+/**
+ * Set the current child of a virtual node
+ *
+ * @param index The index of the virtual child which shall become the current child
+ */
+void NaviEngine::setCurrentChild(int index)
+{
+    menuStack.back().state.currentChild = index;
 }
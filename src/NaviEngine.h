@@ -23,12 +23,24 @@
 #include "Nodes/AnyNode.h"
 #include "Nodes/MenuNode.h"
 
-#include <stack>
+#include <deque>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace naviengine
 {
 
+class NodePreparer;
+class MemoryBudget;
+class OpenCompletions;
+class HookWatchdog;
+struct HookTiming;
+class ModelPublisher;
+class UriIndex;
+class CommandLog;
+struct ModelVersion;
+
 /**
  * NaviEngine relays commands to the current node and keeps track of open menus.
  * The menu can be e.g. a service, a book, or a context menu.
@@ -44,27 +56,55 @@ public:
     bool up();
     bool select();
     bool selectNodeByUri(std::string uri);
+    bool selectNodeById(uint64_t id);
+    bool selectPath(const std::vector<std::string>& uris);
+    bool selectPath(const std::vector<int>& indices);
     bool next();
     bool prev();
 
     bool openContextMenu();
     bool openMenu(AnyNode* node, bool narrable = true);
+    bool openSharedMenu(AnyNode* node, bool narrable = true);
+    bool openPublishedMenu(ModelPublisher* publisher, bool narrable = true);
     bool closeMenu();
 
+    bool back();
+    bool forward();
+
     void narrateNode();
     void narrateNode(AnyNode* node);
     bool renderNode(AnyNode* node);
 
     bool good() const;
 
+    unsigned long deferOpen(AnyNode* node);
+    void completeOpen(unsigned long ticket);
+    bool deliverCompletions();
+    bool openPending() const;
+
+    void beginBatch();
+    bool commit();
+    bool inBatch() const;
+
+    void setPrepareNeighbours(bool enable);
+    void setMemoryBudget(size_t bytes);
+    size_t memoryInUse() const;
+    void setHistorySize(size_t entries);
+    void setUriIndex(const UriIndex* index);
+    void setCommandLog(CommandLog* log);
+
     bool process(int command, void* data = 0);
+    bool process(int command, void* data, size_t size);
 
     int numberOfChildren(AnyNode* node);
+    int numberOfMenus() const;
 
     AnyNode* getCurrentNode();
     void setCurrentNode(AnyNode* node);
     AnyNode* getCurrentChoice();
     void setCurrentChoice(AnyNode* node);
+    int getCurrentChild();
+    void setCurrentChild(int index);
 
     /**
      * Build a context menu.
@@ -80,6 +120,12 @@ public:
     {
         AnyNode* currentNode;
         AnyNode* currentChoice;
+        /**
+         * Index of the current child when the current node is virtual. Nodes
+         * that order their children themselves, e.g. MenuViewNode, may keep
+         * the position of the choice here and must check it against the choice.
+         */
+        int currentChild;
     };
 
     /**
@@ -88,15 +134,114 @@ public:
     struct MenuState
     {
         AnyNode* menuModel;
+        /** If false, the model is shared and not deleted when the menu is closed */
+        bool ownsModel;
         selection_type state;
         MenuState() :
-                menuModel(NULL)
+                menuModel(NULL), ownsModel(true)
         {
             state.currentNode = NULL;
             state.currentChoice = NULL;
+            state.currentChild = 0;
         }
     };
 
+    static uint64_t choiceId(const MenuState& state);
+
+    /**
+     * Flags describing what changed during a command
+     */
+    enum RenderChange
+    {
+        /** The current choice or virtual child moved */
+        CHOICE_MOVED = 1,
+        /** Another node became the current node */
+        NODE_OPENED = 2,
+        /** A menu was opened or closed, or the model was replaced */
+        MENU_CHANGED = 4,
+        /** Children were inserted or removed, reported by markDirty */
+        CHILDREN_CHANGED = 8,
+        /** A name or info was updated, reported by markDirty */
+        CONTENT_CHANGED = 16
+    };
+
+    /**
+     * A data type to hold the changes made by a command
+     */
+    struct RenderDelta
+    {
+        /** The RenderChange flags of all changes */
+        int changes;
+        /** The selection before the command, for comparison only */
+        selection_type before;
+        /** The selection after the command */
+        selection_type after;
+        /** The nodes reported by markDirty with their RenderChange flags */
+        std::vector<std::pair<AnyNode*, int> > nodes;
+    };
+
+    void markDirty(AnyNode* node, int changes);
+
+    /**
+     * A data type to hold one child in a window
+     */
+    struct WindowEntry
+    {
+        /** The child, or NULL for a virtual child */
+        AnyNode* node;
+        /** The position of the child among all children, starting from 0 */
+        int index;
+    };
+
+    /**
+     * A data type to hold the children around the current choice
+     */
+    struct Window
+    {
+        /** The children in the window, in order */
+        std::vector<WindowEntry> entries;
+        /** The number of children of the current node */
+        int total;
+        /** The index of the current choice, or -1 if it is not a child */
+        int current;
+    };
+
+    Window visibleWindow(int before, int after);
+
+    /**
+     * Node hooks that can be given a time budget
+     */
+    enum Hook
+    {
+        /** beforeOnOpen and onOpen, or onOpenComplete */
+        HOOK_OPEN = 0,
+        /** process */
+        HOOK_PROCESS = 1,
+        /** onNarrate */
+        HOOK_NARRATE = 2,
+        /** onRender */
+        HOOK_RENDER = 3
+    };
+
+    /**
+     * A data type to hold the budget violations of one hook by one node type
+     */
+    struct HookViolation
+    {
+        /** The name of the node type */
+        std::string type;
+        /** The hook that exceeded its budget */
+        Hook hook;
+        /** The number of invocations that exceeded the budget */
+        unsigned int count;
+        /** The longest of those invocations in microseconds */
+        unsigned int worst;
+    };
+
+    void setHookBudget(Hook hook, unsigned int microseconds);
+    std::vector<HookViolation> hookViolations() const;
+    void resetHookViolations();
+
 private:
     /**
      * NaviEngine call this functions when state changes
@@ -122,12 +267,128 @@ private:
      * NaviEngine call this function when state changes
      */
     virtual void narrateLongPause() = 0;
+    /**
+     * NaviEngine call this function after each command that changed something,
+     * so only the changed parts need to be rendered again
+     */
+    virtual void renderChange(const RenderDelta& delta);
+    /**
+     * NaviEngine call this function after a command that left a node loading
+     */
+    virtual void narrateLoading(const AnyNode* node);
+    /**
+     * NaviEngine call this function from the thread that completed an open,
+     * so the engine thread can be woken up to call deliverCompletions
+     */
+    virtual void openCompleted();
 
+    friend class CommandScope;
+    friend class AnyNode;
+    friend class CommandLog;
+    void beginCommand();
+    void endCommand();
+    void schedulePreparation();
+    void accountOpened(AnyNode* node);
+    void evictNodes();
+    void syncModel();
+    bool syncMenu(MenuState& menu, std::vector<selection_type>* trail, const AnyNode* oldRoot);
+    void startDelta();
+    void emitDelta();
+    void updateTrail();
+    void abortOpen(const AnyNode* model);
+    void forgetOpen(const AnyNode* node);
+    void checkPendingOpen();
+    HookTiming startHook(const AnyNode* node) const;
+    bool endHook(Hook hook, const AnyNode* node, const HookTiming& timing);
+    bool narrateFallback(const AnyNode* node) const;
+    bool logCommand(int command, int64_t value = 0, const std::string& uri = std::string());
+    void logState();
+    void commandState(std::vector<int>& path, int& choice);
+    bool processCommand(int command, void* data, int64_t size);
+
+    /**
+     * A data type to hold a visited node for back and forward
+     */
+    struct HistoryEntry
+    {
+        /** The model of the menu the node was visited in */
+        AnyNode* menuModel;
+        /** The selection at the end of the last command on the node */
+        selection_type state;
+        /** The index of the choice among the children of the node */
+        int choice;
+        /** The selections from the model to the node */
+        std::vector<selection_type> trail;
+        /** The index of each selection's choice among its node's children */
+        std::vector<int> path;
+    };
+
+    void recordHistory();
+    int choiceIndex(const selection_type& state);
+    bool restoreHistory(const HistoryEntry& entry);
+    void forgetHistory(const AnyNode* model);
+    void rebuildTrail(std::vector<selection_type>& trail, const MenuState& menu);
+
+    bool pushMenu(AnyNode* node, bool narrable, bool owned);
+    void releaseModel(AnyNode* model, bool owned);
     bool stateHasChanged(const MenuState& before);
+    bool openNode(AnyNode* node);
+    void announceChange(const MenuState& before, const MenuState& after);
     bool openOnChange(const MenuState& before);
-    std::stack<MenuState> menuStack;
+    /**
+     * A data type to hold what is restored if selecting a path fails
+     */
+    struct PathStart
+    {
+        /** The state of the menu before the path was selected */
+        MenuState before;
+        /** The menu stack size before the path was selected */
+        size_t depth;
+        /** The trail of the menu before the path was selected */
+        std::vector<selection_type> trail;
+        /** The intermediate nodes opened along the path */
+        std::vector<AnyNode*> opened;
+    };
+
+    void startPath(PathStart& path, const MenuState& before);
+    bool descendInto(AnyNode* child, bool last, PathStart& path);
+    bool finishPath(PathStart& path, bool success);
+    bool selectIndexedUri(const std::string& uri, const MenuState& before);
+    std::deque<MenuState> menuStack;
+    std::deque<std::vector<selection_type> > trails_;
     bool good_;
-    bool openOnChange_;
+    int batchDepth_;
+    MenuState batchBefore_;
+    size_t batchMenus_;
+    /** Owned models of menus closed during the batch, deleted when it is committed */
+    std::vector<AnyNode*> batchClosed_;
+    int commandDepth_;
+    MenuState commandStart_;
+    size_t commandMenus_;
+    size_t commandTrail_;
+    NodePreparer* preparer_;
+    MemoryBudget* budget_;
+    ModelPublisher* publisher_;
+    ModelVersion* version_;
+    bool deltaPending_;
+    MenuState deltaStart_;
+    size_t deltaMenus_;
+    std::vector<std::pair<AnyNode*, int> > dirtyNodes_;
+    std::deque<HistoryEntry> history_;
+    size_t historySize_;
+    size_t historyCursor_;
+    bool historyMoving_;
+    const UriIndex* uriIndex_;
+    OpenCompletions* completions_;
+    /** The node whose open is deferred, if any */
+    AnyNode* pendingNode_;
+    /** The model of the menu the deferred open was started in */
+    const AnyNode* pendingModel_;
+    unsigned long pendingTicket_;
+    unsigned long lastTicket_;
+    bool loadingPending_;
+    HookWatchdog* watchdog_;
+    CommandLog* commandLog_;
 };
 }
 #endif
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NodePreparer.h"
+#include "Trace.h"
+#include "Nodes/AnyNode.h"
+
+#include <algorithm>
+#include <sched.h>
+
+using namespace naviengine;
+
+namespace
+{
+/** The cancel flag of the preparation running on this thread, if any */
+__thread const int* cancelFlag = NULL;
+}
+
+/**
+ * Constructor
+ *
+ * Starts the worker thread
+ */
+NodePreparer::NodePreparer() :
+        current_(NULL), cancelled_(NULL), stop_(false)
+{
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&wake_, NULL);
+    pthread_cond_init(&idle_, NULL);
+    pthread_create(&thread_, NULL, NodePreparer::run, this);
+}
+
+/**
+ * Destructor
+ *
+ * Drops scheduled nodes and joins the worker thread
+ */
+NodePreparer::~NodePreparer()
+{
+    pthread_mutex_lock(&mutex_);
+    dropQueue();
+    cancelCurrent();
+    stop_ = true;
+    pthread_cond_signal(&wake_);
+    pthread_mutex_unlock(&mutex_);
+
+    pthread_join(thread_, NULL);
+    pthread_cond_destroy(&idle_);
+    pthread_cond_destroy(&wake_);
+    pthread_mutex_destroy(&mutex_);
+}
+
+/**
+ * Schedule nodes for preparation
+ *
+ * Replaces any nodes that are still waiting to be prepared. A node that
+ * another preparer has scheduled is left to it.
+ *
+ * @param nodes The nodes to prepare, in order
+ */
+void NodePreparer::schedule(const std::vector<AnyNode*>& nodes)
+{
+    pthread_mutex_lock(&mutex_);
+    dropQueue();
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        // Preparers of engines sharing a model claim nodes concurrently
+        if (not __sync_bool_compare_and_swap(&nodes[i]->preparing_, (NodePreparer*) NULL, this)
+                && __atomic_load_n(&nodes[i]->preparing_, __ATOMIC_ACQUIRE) != this)
+            continue;
+        queue_.push_back(nodes[i]);
+    }
+    pthread_cond_signal(&wake_);
+    pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Cancel scheduled preparations
+ *
+ * Drops nodes that are waiting to be prepared and asks a prepare that is
+ * already running to return early. Does not wait for it, see wait.
+ */
+void NodePreparer::cancel()
+{
+    pthread_mutex_lock(&mutex_);
+    dropQueue();
+    cancelCurrent();
+    pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Wait for a running prepare to return
+ *
+ * @param node Only wait if this node is being prepared, or NULL to wait for any node
+ */
+void NodePreparer::wait(const AnyNode* node)
+{
+    pthread_mutex_lock(&mutex_);
+    while (current_ != NULL && (node == NULL || current_ == node))
+        pthread_cond_wait(&idle_, &mutex_);
+    pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Forget a node that is about to be deleted
+ *
+ * The node is dropped if it is waiting to be prepared, and a running
+ * prepare of it is cancelled and waited for.
+ *
+ * @param node The node
+ */
+void NodePreparer::forget(AnyNode* node)
+{
+    pthread_mutex_lock(&mutex_);
+    std::deque<AnyNode*>::iterator it = std::find(queue_.begin(), queue_.end(), node);
+    if (it != queue_.end())
+        queue_.erase(it);
+    if (current_ == node)
+        cancelCurrent();
+    while (current_ == node)
+        pthread_cond_wait(&idle_, &mutex_);
+    __sync_bool_compare_and_swap(&node->preparing_, this, (NodePreparer*) NULL);
+    pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Ask the running prepare, if any, to return early, the mutex must be held
+ */
+void NodePreparer::cancelCurrent()
+{
+    if (cancelled_ != NULL)
+        __atomic_store_n(cancelled_, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Drop the nodes waiting to be prepared, the mutex must be held
+ */
+void NodePreparer::dropQueue()
+{
+    for (size_t i = 0; i < queue_.size(); ++i)
+    {
+        if (queue_[i] != current_)
+            __atomic_store_n(&queue_[i]->preparing_, (NodePreparer*) NULL, __ATOMIC_RELEASE);
+    }
+    queue_.clear();
+}
+
+void* NodePreparer::run(void* preparer)
+{
+#ifdef SCHED_IDLE
+    // Only use cpu time nobody else wants
+    struct sched_param param;
+    param.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+    static_cast<NodePreparer*>(preparer)->work();
+    return NULL;
+}
+
+void NodePreparer::work()
+{
+    pthread_mutex_lock(&mutex_);
+    while (not stop_)
+    {
+        if (queue_.empty())
+        {
+            pthread_cond_wait(&wake_, &mutex_);
+            continue;
+        }
+
+        AnyNode* node = queue_.front();
+        queue_.pop_front();
+        int cancelled = 0;
+        current_ = node;
+        cancelled_ = &cancelled;
+        pthread_mutex_unlock(&mutex_);
+
+        {
+            TraceScope trace("prepare", node);
+            cancelFlag = &cancelled;
+            node->prepare();
+            cancelFlag = NULL;
+        }
+
+        pthread_mutex_lock(&mutex_);
+        cancelled_ = NULL;
+        if (std::find(queue_.begin(), queue_.end(), node) == queue_.end())
+            __atomic_store_n(&node->preparing_, (NodePreparer*) NULL, __ATOMIC_RELEASE);
+        current_ = NULL;
+        pthread_cond_broadcast(&idle_);
+    }
+    pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Remove this node from the preparer before it is deleted
+ */
+void AnyNode::leavePrepare()
+{
+    NodePreparer* preparer;
+    while ((preparer = __atomic_load_n(&preparing_, __ATOMIC_ACQUIRE)) != NULL)
+        preparer->forget(this);
+}
+
+/**
+ * Check if the running prepare should return early
+ *
+ * @return true if the engine has started a command since the preparation was scheduled, otherwise false
+ */
+bool AnyNode::prepareCancelled()
+{
+    return cancelFlag != NULL && __atomic_load_n(cancelFlag, __ATOMIC_ACQUIRE) != 0;
+}
+
+/**
+ * Delete a node once a running prepare of it has returned
+ *
+ * @param node The node to delete, or NULL
+ */
+void AnyNode::destroy(AnyNode* node)
+{
+    if (node != NULL && __atomic_load_n(&node->preparing_, __ATOMIC_ACQUIRE) != NULL)
+        node->leavePrepare();
+    delete node;
+}
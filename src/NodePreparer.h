@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAVIENGINE_NODEPREPARER
+#define NAVIENGINE_NODEPREPARER
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+namespace naviengine
+{
+
+class AnyNode;
+
+/**
+ * NodePreparer invokes AnyNode::prepare on a low priority background thread.
+ *
+ * NaviEngine schedules the current choice and its neighbours after each
+ * command and cancels them when the next one starts. A prepare that is
+ * already running is asked to return early, see AnyNode::prepareCancelled,
+ * and the engine only waits for it before it invokes a hook of the node or
+ * deletes the node. Each preparation has a cancel flag of its own, so
+ * scheduling new nodes never resumes a cancelled one.
+ */
+class NodePreparer
+{
+public:
+    NodePreparer();
+    ~NodePreparer();
+
+    void schedule(const std::vector<AnyNode*>& nodes);
+    void cancel();
+    void wait(const AnyNode* node = 0);
+
+private:
+    friend class AnyNode;
+    static void* run(void* preparer);
+    void work();
+    void forget(AnyNode* node);
+    void cancelCurrent();
+    void dropQueue();
+
+    pthread_t thread_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t wake_;
+    pthread_cond_t idle_;
+    std::deque<AnyNode*> queue_;
+    /** The node being prepared, if any */
+    AnyNode* current_;
+    /** The cancel flag of the running prepare, if any */
+    int* cancelled_;
+    bool stop_;
+};
+}
+#endif
@@ -20,6 +20,7 @@
 #ifndef NAVIENGINE_ANYNODE
 #define NAVIENGINE_ANYNODE
 
+#include <stdint.h>
 #include <utility>
 #include <string>
 
@@ -28,6 +29,9 @@ namespace naviengine
 
 class NaviEngine;
 class AnyNode;
+class MemoryBudget;
+class NodePreparer;
+struct BudgetEntry;
 
 /**
  * The abstract base node.
@@ -39,7 +43,7 @@ public:
      * Constructor
      */
     AnyNode() :
-            parent_(0), prev_(0), next_(0)
+            parent_(0), prev_(0), next_(0), id_(nextId()), budgetEntry_(0), position_(-1), links_(0), opening_(0), preparing_(0)
     {
     }
 
@@ -48,6 +52,12 @@ public:
      */
     virtual ~AnyNode()
     {
+        if (budgetEntry_ != 0)
+            leaveBudget();
+        if (__atomic_load_n(&opening_, __ATOMIC_ACQUIRE) != 0)
+            leaveOpen();
+        if (__atomic_load_n(&preparing_, __ATOMIC_ACQUIRE) != 0)
+            leavePrepare();
     }
 
     /**
@@ -58,6 +68,70 @@ public:
         return NULL;
     }
 
+    /**
+     * Get a child in this node by its position.
+     *
+     * @param index The position of the child, starting from 0.
+     * @return A pointer to the child, or NULL if there is no such child.
+     */
+    virtual AnyNode* childAt(int index) const
+    {
+        AnyNode* first = firstChild();
+        AnyNode* child = (index < 0) ? NULL : first;
+        for (int n = 0; child != NULL && n < index; ++n)
+        {
+            child = child->next_;
+            if (child == first)
+                child = NULL;
+        }
+        return child;
+    }
+
+    /**
+     * Get the position of a child in this node.
+     *
+     * @param child The child to look for.
+     * @return The position of the child starting from 0, or -1 if it is not a child.
+     */
+    virtual int indexOf(const AnyNode* child) const
+    {
+        AnyNode* first = firstChild();
+        const AnyNode* tmp = first;
+        for (int n = 0; tmp != NULL; ++n)
+        {
+            if (tmp == child)
+                return n;
+            tmp = tmp->next_;
+            if (tmp == first)
+                tmp = NULL;
+        }
+        return -1;
+    }
+
+    /**
+     * Get the id of a child in this node by its position.
+     *
+     * @param index The position of the child, starting from 0.
+     * @return The id of the child, or 0 if there is no such child.
+     */
+    virtual uint64_t childId(int index) const
+    {
+        AnyNode* child = childAt(index);
+        return (child != NULL) ? child->id_ : 0;
+    }
+
+    /**
+     * Get the uri of a child in this node by its position.
+     *
+     * @param index The position of the child, starting from 0.
+     * @return The uri of the child, or an empty string if there is no such child.
+     */
+    virtual std::string childUri(int index) const
+    {
+        AnyNode* child = childAt(index);
+        return (child != NULL) ? child->uri_ : std::string();
+    }
+
     /**
      * Open child in this node.
      *
@@ -65,6 +139,18 @@ public:
      */
     virtual bool select(NaviEngine&) = 0;
 
+    /**
+     * Open child by id in this node.
+     *
+     * Only called for virtual nodes, NaviEngine finds other children itself.
+     *
+     * @return true on success.
+     */
+    virtual bool selectById(NaviEngine&, uint64_t)
+    {
+        return false;
+    }
+
     /**
      * Open child by uri in this node.
      *
@@ -107,6 +193,30 @@ public:
      */
     virtual bool onOpen(NaviEngine&) = 0;
 
+    /**
+     * Finish an open that was deferred with NaviEngine::deferOpen.
+     *
+     * Called on the engine thread when the open has been completed with
+     * NaviEngine::completeOpen. Apply the loaded data to the model here.
+     *
+     * @return true on successful open.
+     */
+    virtual bool onOpenComplete(NaviEngine&)
+    {
+        return true;
+    }
+
+    /**
+     * Undo an onOpen the user never got to see.
+     *
+     * Called when a node was opened as an intermediate step of
+     * NaviEngine::selectPath and the rest of the path could not be selected.
+     * Release what onOpen built here if it is not needed otherwise.
+     */
+    virtual void onClose(NaviEngine&)
+    {
+    }
+
     /**
      * A place holder for logic that must be executed before onOpen in called
      */
@@ -158,10 +268,126 @@ public:
      * Implement this method if the node is doing async work that needs
      * to be aborted
      *
+     * NaviEngine calls this when the user navigates away from a node whose
+     * open is deferred. A completion for the aborted open is ignored.
+     *
      * @return false if the operation failed
      */
     virtual bool abort() = 0;
 
+    /**
+     * Get the number of children in this node.
+     *
+     * @return The number of children, found by walking the children by default.
+     */
+    virtual int numberOfChildren()
+    {
+        AnyNode* first = firstChild();
+        if (first == NULL)
+            return 0;
+
+        int num = 0;
+        const AnyNode* tmp = first;
+        do
+        {
+            tmp = tmp->next_;
+            num++;
+        } while (tmp != first && tmp != NULL);
+
+        return num;
+    }
+
+    /**
+     * Get the position of the current choice when this node is the current node.
+     *
+     * Nodes that show children in another order than their parents do, e.g.
+     * views, implement this so the choice is narrated at the right position.
+     *
+     * @return The position starting from 1, or 0 to use the position among siblings.
+     */
+    virtual int currentPosition(NaviEngine&)
+    {
+        return 0;
+    }
+
+    /**
+     * Load data that beforeOnOpen and onOpen will need, ahead of time.
+     *
+     * If enabled, NaviEngine calls this from a low priority background thread
+     * when the node becomes the current choice or one of its neighbours. It may
+     * be called again for an already prepared node. It must not change the model.
+     *
+     * It may still be running when the next command starts. The engine then
+     * asks it to return early, see prepareCancelled, and only waits for it
+     * before it invokes a hook of this node or the node is deleted, see
+     * destroy. It may run while the engine narrates or renders, so it must
+     * only read what those read. Long preparations should check
+     * prepareCancelled regularly.
+     */
+    virtual void prepare()
+    {
+    }
+
+    /**
+     * Get a number that changes whenever children are added, removed or reordered.
+     *
+     * @return The generation of the children of this node.
+     */
+    virtual unsigned int childrenGeneration() const
+    {
+        return 0;
+    }
+
+    /**
+     * Get the approximate memory held by this node, not counting its children.
+     *
+     * @return The approximate number of bytes held by this node.
+     */
+    virtual size_t memoryUsage() const
+    {
+        return sizeof(*this) + name_.capacity() + info_.capacity() + uri_.capacity();
+    }
+
+    /**
+     * Release children that onOpen can build again.
+     *
+     * NaviEngine calls this for nodes that are not on the navigation path when
+     * its memory budget is exceeded. The node is opened again before its
+     * children are used. Nodes keep their children by default; MenuNode and
+     * VirtualMenuNode release them when made evictable with setEvictable.
+     *
+     * @return true if memory was released, false if the node keeps its children.
+     */
+    virtual bool evict()
+    {
+        return false;
+    }
+
+    /**
+     * Get a new id for a node or virtual node.
+     *
+     * @return An id never returned before, safe to call from any thread.
+     */
+    static uint64_t nextId();
+
+    /**
+     * Check if prepare should return early because a command has started.
+     *
+     * @return true if prepare is running on this thread and was cancelled.
+     */
+    static bool prepareCancelled();
+
+    /**
+     * Delete a node once a running prepare of it has returned.
+     *
+     * The destructor of AnyNode runs after those of derived classes, too late
+     * to keep a running prepare from using what they freed. MenuNode,
+     * MenuLinkNode, ModelPublisher and NaviEngine delete nodes this way; use
+     * it instead of delete for nodes of a model an engine may prepare.
+     *
+     * @param node The node to delete, or NULL.
+     */
+    static void destroy(AnyNode* node);
 
 public:
     /** Pointer to the parent node */
@@ -176,6 +402,28 @@ public:
     std::string info_;
     /** Variable holding the uri of this node */
     std::string uri_;
+    /** Id of this node, unique among all nodes and virtual nodes and never reused */
+    uint64_t id_;
+
+private:
+    friend class MemoryBudget;
+    friend class NaviEngine;
+    friend class MenuNode;
+    friend class MenuLinkNode;
+    friend class NodePreparer;
+    void leaveBudget();
+    void leaveOpen();
+    void leavePrepare();
+    /** Entry of this node in the memory budget tracking it, if any */
+    BudgetEntry* budgetEntry_;
+    /** Position of this node in the MenuNode it was last added to */
+    int position_;
+    /** Number of MenuLinkNodes sharing this node */
+    int links_;
+    /** The engine waiting for this node to complete a deferred open, if any, accessed atomically */
+    NaviEngine* opening_;
+    /** The preparer that has scheduled this node, if any, accessed atomically as engines may share the node */
+    NodePreparer* preparing_;
 };
 }
 
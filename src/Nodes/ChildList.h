@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAVIENGINE_CHILDLIST
+#define NAVIENGINE_CHILDLIST
+
+#include <stddef.h>
+#include <string.h>
+
+namespace naviengine
+{
+
+class AnyNode;
+
+/**
+ * A list of child pointers that keeps the first few children inside the
+ * owning node and only allocates when there are more.
+ */
+class ChildList
+{
+public:
+    /** The number of children kept without allocating */
+    enum
+    {
+        INLINE_CAPACITY = 8
+    };
+
+    ChildList() :
+            data_(inline_), size_(0), capacity_(INLINE_CAPACITY)
+    {
+    }
+
+    ~ChildList()
+    {
+        if (data_ != inline_)
+            delete[] data_;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    /**
+     * Get the number of bytes allocated outside the owning node
+     */
+    size_t heapBytes() const
+    {
+        return (data_ != inline_) ? capacity_ * sizeof(AnyNode*) : 0;
+    }
+
+    AnyNode* operator[](size_t index) const
+    {
+        return data_[index];
+    }
+
+    AnyNode* front() const
+    {
+        return data_[0];
+    }
+
+    AnyNode* back() const
+    {
+        return data_[size_ - 1];
+    }
+
+    void push_back(AnyNode* child)
+    {
+        if (size_ == capacity_)
+            reserve(capacity_ * 2);
+        data_[size_++] = child;
+    }
+
+    /**
+     * Make room for a number of children
+     */
+    void reserve(size_t capacity)
+    {
+        if (capacity <= capacity_)
+            return;
+
+        AnyNode** data = new AnyNode*[capacity];
+        memcpy(data, data_, size_ * sizeof(AnyNode*));
+        if (data_ != inline_)
+            delete[] data_;
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    /**
+     * Remove all children and release the allocated storage
+     */
+    void clear()
+    {
+        if (data_ != inline_)
+            delete[] data_;
+        data_ = inline_;
+        size_ = 0;
+        capacity_ = INLINE_CAPACITY;
+    }
+
+private:
+    ChildList(const ChildList&);
+    ChildList& operator=(const ChildList&);
+
+    AnyNode** data_;
+    size_t size_;
+    size_t capacity_;
+    AnyNode* inline_[INLINE_CAPACITY];
+};
+}
+#endif
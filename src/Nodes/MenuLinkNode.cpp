@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MenuLinkNode.h"
+#include "NaviEngine.h"
+
+#include <sstream>
+
+using namespace naviengine;
+
+/**
+ * Constructor.
+ *
+ * Takes the name and info of the target and generates a unique uri for this
+ * node, so each place the subtree appears in can be told apart.
+ *
+ * @param target The root of the shared subtree, released when the link is deleted.
+ */
+MenuLinkNode::MenuLinkNode(AnyNode* target) :
+        target_(target)
+{
+    __sync_add_and_fetch(&target_->links_, 1);
+    name_ = target->name_;
+    info_ = target->info_;
+
+    std::ostringstream uri_from_anything;
+    uri_from_anything << id_;
+    uri_ = uri_from_anything.str();
+}
+
+/**
+ * Destructor.
+ *
+ * Deletes the target if this was its last link.
+ */
+MenuLinkNode::~MenuLinkNode()
+{
+    if (__sync_sub_and_fetch(&target_->links_, 1) == 0)
+        AnyNode::destroy(target_);
+}
+
+/**
+ * Get the first child of the target.
+ *
+ * @return A pointer to the first child, or NULL if the target has none.
+ */
+AnyNode* MenuLinkNode::firstChild() const
+{
+    return target_->firstChild();
+}
+
+/**
+ * Get a child of the target by its position.
+ *
+ * @param index The position of the child, starting from 0.
+ * @return A pointer to the child, or NULL if there is no such child.
+ */
+AnyNode* MenuLinkNode::childAt(int index) const
+{
+    return target_->childAt(index);
+}
+
+/**
+ * Get the position of a child of the target.
+ *
+ * @param child The child to look for.
+ * @return The position of the child starting from 0, or -1 if it is not a child.
+ */
+int MenuLinkNode::indexOf(const AnyNode* child) const
+{
+    return target_->indexOf(child);
+}
+
+/**
+ * Get the id of a child of the target by its position.
+ *
+ * @param index The position of the child, starting from 0.
+ * @return The id of the child, or 0 if there is no such child.
+ */
+uint64_t MenuLinkNode::childId(int index) const
+{
+    return target_->childId(index);
+}
+
+/**
+ * Get the uri of a child of the target by its position.
+ *
+ * @param index The position of the child, starting from 0.
+ * @return The uri of the child, or an empty string if there is no such child.
+ */
+std::string MenuLinkNode::childUri(int index) const
+{
+    return target_->childUri(index);
+}
+
+/**
+ * Get the shared subtree.
+ *
+ * @return A pointer to the root of the shared subtree.
+ */
+AnyNode* MenuLinkNode::target() const
+{
+    return target_;
+}
+
+/**
+ * Get the number of links sharing the target.
+ *
+ * @return The number of links, including this one.
+ */
+int MenuLinkNode::links() const
+{
+    return __sync_add_and_fetch(&target_->links_, 0);
+}
+
+bool MenuLinkNode::up(NaviEngine& navi)
+{
+    navi.setCurrentNode(this->parent_);
+    navi.setCurrentChoice(this);
+
+    if (parent_ == 0)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool MenuLinkNode::prev(NaviEngine& navi)
+{
+    return target_->prev(navi);
+}
+
+bool MenuLinkNode::next(NaviEngine& navi)
+{
+    return target_->next(navi);
+}
+
+bool MenuLinkNode::select(NaviEngine& navi)
+{
+    return target_->select(navi);
+}
+
+bool MenuLinkNode::selectByUri(NaviEngine& navi, std::string uri)
+{
+    return target_->selectByUri(navi, uri);
+}
+
+bool MenuLinkNode::selectById(NaviEngine& navi, uint64_t id)
+{
+    return target_->selectById(navi, id);
+}
+
+bool MenuLinkNode::menu(NaviEngine& navi)
+{
+    return target_->menu(navi);
+}
+
+bool MenuLinkNode::onOpen(NaviEngine& navi)
+{
+    return target_->onOpen(navi);
+}
+
+bool MenuLinkNode::onOpenComplete(NaviEngine& navi)
+{
+    return target_->onOpenComplete(navi);
+}
+
+void MenuLinkNode::beforeOnOpen()
+{
+    target_->beforeOnOpen();
+}
+
+bool MenuLinkNode::narrateName()
+{
+    return target_->narrateName();
+}
+
+bool MenuLinkNode::narrateInfo()
+{
+    return target_->narrateInfo();
+}
+
+bool MenuLinkNode::onNarrate()
+{
+    return target_->onNarrate();
+}
+
+bool MenuLinkNode::onRender()
+{
+    return target_->onRender();
+}
+
+bool MenuLinkNode::isVirtual()
+{
+    return target_->isVirtual();
+}
+
+bool MenuLinkNode::process(NaviEngine& navi, int command, void* data)
+{
+    return target_->process(navi, command, data);
+}
+
+bool MenuLinkNode::abort()
+{
+    return target_->abort();
+}
+
+void MenuLinkNode::prepare()
+{
+    target_->prepare();
+}
+
+/**
+ * Get a number that changes whenever the children of the target change.
+ *
+ * @return The generation of the children of the target.
+ */
+unsigned int MenuLinkNode::childrenGeneration() const
+{
+    return target_->childrenGeneration();
+}
+
+/**
+ * Get the memory held by the link, not counting the shared subtree.
+ *
+ * @return The approximate number of bytes held by this node.
+ */
+size_t MenuLinkNode::memoryUsage() const
+{
+    return sizeof(*this) + name_.capacity() + info_.capacity() + uri_.capacity();
+}
+
+/**
+ * Get the number of children of the target.
+ *
+ * @return Number of children.
+ */
+int MenuLinkNode::numberOfChildren()
+{
+    return target_->numberOfChildren();
+}
+
+/**
+ * Get the position of the current choice in the target.
+ *
+ * @return The position starting from 1, or 0 to use the position among siblings.
+ */
+int MenuLinkNode::currentPosition(NaviEngine& navi)
+{
+    return target_->currentPosition(navi);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAVIENGINE_MENULINKNODE
+#define NAVIENGINE_MENULINKNODE
+
+#include "AnyNode.h"
+
+#include <string>
+
+namespace naviengine
+{
+class NaviEngine;
+
+/**
+ * A reference to a subtree shared by several parents
+ *
+ * The same subtree, e.g. a settings or help menu, can appear under several
+ * parents by adding a link to it to each parent instead of a copy. The link
+ * shows the children of its target and forwards the hooks of the target to
+ * it. The target is reference counted by its links and deleted with the last
+ * one, so it must not be added to a menu node itself. Going up from a child
+ * opened through a link returns to the link it was opened through.
+ */
+class MenuLinkNode: public AnyNode
+{
+public:
+    MenuLinkNode(AnyNode* target);
+    ~MenuLinkNode();
+    AnyNode* firstChild() const;
+    AnyNode* childAt(int index) const;
+    int indexOf(const AnyNode* child) const;
+    uint64_t childId(int index) const;
+    std::string childUri(int index) const;
+    AnyNode* target() const;
+    int links() const;
+
+    bool up(NaviEngine& navi);
+    bool prev(NaviEngine& navi);
+    bool next(NaviEngine& navi);
+    bool select(NaviEngine& navi);
+    bool selectByUri(NaviEngine& navi, std::string uri);
+    bool selectById(NaviEngine& navi, uint64_t id);
+    bool menu(NaviEngine& navi);
+    bool onOpen(NaviEngine& navi);
+    bool onOpenComplete(NaviEngine& navi);
+    void beforeOnOpen();
+    bool narrateName();
+    bool narrateInfo();
+    bool onNarrate();
+    bool onRender();
+    bool isVirtual();
+    bool process(NaviEngine&, int command, void* data = 0);
+    bool abort();
+    void prepare();
+
+    unsigned int childrenGeneration() const;
+    size_t memoryUsage() const;
+
+    int numberOfChildren();
+    int currentPosition(NaviEngine& navi);
+
+private:
+    MenuLinkNode(const MenuLinkNode&);
+    MenuLinkNode& operator=(const MenuLinkNode&);
+
+    /** The shared subtree */
+    AnyNode* target_;
+};
+}
+#endif
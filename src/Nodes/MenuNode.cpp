@@ -18,12 +18,19 @@
  */
 
 #include "MenuNode.h"
+#include "MenuViewNode.h"
 #include "NaviEngine.h"
 
 #include <sstream>
 
 using namespace naviengine;
 
+namespace
+{
+/** The descendants left to delete by the outermost MenuNode destructor on this thread */
+__thread std::vector<AnyNode*>* deleting = NULL;
+}
+
 /**
  * Constructor.
  *
@@ -31,12 +38,13 @@ using namespace naviengine;
  *
  * @param name The name of this node.
  */
-MenuNode::MenuNode(const std::string& name)
+MenuNode::MenuNode(const std::string& name) :
+        views_(NULL), generation_(0), evictable_(false)
 {
     name_ = name;
 
     std::ostringstream uri_from_anything;
-    uri_from_anything << reinterpret_cast<long>(this);
+    uri_from_anything << id_;
     uri_ = uri_from_anything.str();
 }
 
@@ -44,14 +52,47 @@ MenuNode::MenuNode(const std::string& name)
 /**
  * Destructor.
  *
- * Deletes all its children.
+ * Deletes all its children, see deleteNodes. Its views show no children
+ * afterwards.
  */
 MenuNode::~MenuNode()
 {
-    for (size_t i = 0; i < children.size(); ++i)
+    for (MenuViewNode* view = views_; view != NULL; view = view->nextView_)
+        view->source_ = NULL;
+    deleteNodes(children);
+}
+
+/**
+ * Delete nodes and all their descendants.
+ *
+ * The outermost deletion on a thread deletes all descendants from a work
+ * list, so the stack depth does not grow with the depth of the tree, and
+ * deletions nested in it only add to the list. Each node is deleted before
+ * its children, and its destructor still sees them. The parent may be gone
+ * when a child is deleted, so the parent of a queued node is cleared.
+ *
+ * @param nodes The nodes to delete.
+ */
+void MenuNode::deleteNodes(const ChildList& nodes)
+{
+    std::vector<AnyNode*> work;
+    std::vector<AnyNode*>* queue = (deleting != NULL) ? deleting : &work;
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        nodes[i]->parent_ = NULL;
+        queue->push_back(nodes[i]);
+    }
+    if (deleting != NULL)
+        return;
+
+    deleting = &work;
+    while (not work.empty())
     {
-        delete children[i];
+        AnyNode* node = work.back();
+        work.pop_back();
+        AnyNode::destroy(node);
     }
+    deleting = NULL;
 }
 
 /**
@@ -78,6 +119,45 @@ AnyNode* MenuNode::lastChild()
     return children[children.size() - 1];
 }
 
+/**
+ * Get a child in this node by its position.
+ *
+ * @param index The position of the child, starting from 0.
+ * @return A pointer to the child, or NULL if there is no such child.
+ */
+AnyNode* MenuNode::childAt(int index) const
+{
+    if (index < 0 || index >= (int) children.size())
+        return NULL;
+    return children[index];
+}
+
+/**
+ * Get the position of a child in this node.
+ *
+ * The position is remembered when the child is added, so this is constant
+ * time for children added to a single menu node.
+ *
+ * @param child The child to look for.
+ * @return The position of the child starting from 0, or -1 if it is not a child.
+ */
+int MenuNode::indexOf(const AnyNode* child) const
+{
+    if (child == NULL)
+        return -1;
+
+    int index = child->position_;
+    if (index >= 0 && index < (int) children.size() && children[index] == child)
+        return index;
+
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        if (children[i] == child)
+            return i;
+    }
+    return -1;
+}
+
 /**
  * Add a child to this node.
  *
@@ -105,19 +185,52 @@ void MenuNode::addNode(AnyNode* node)
         node->prev_ = node;
         node->next_ = node;
     }
+    node->position_ = children.size();
     children.push_back(node);
+    generation_++;
 }
 
 /**
- * Delete all children in this node.
+ * Add several children to this node in one step.
+ *
+ * Works as calling addNode for each node, but the children and the sibling
+ * links are updated once. NULL nodes are skipped.
+ *
+ * @param nodes The children to add, in order.
  */
-void MenuNode::clearNodes()
+void MenuNode::addNodes(const std::vector<AnyNode*>& nodes)
 {
-    for (size_t i = 0; i < children.size(); ++i)
+    size_t first = children.size();
+    children.reserve(first + nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i)
     {
-        delete children[i];
+        if (nodes[i] == NULL)
+            continue;
+        nodes[i]->parent_ = this;
+        nodes[i]->position_ = children.size();
+        children.push_back(nodes[i]);
     }
+    if (children.size() == first)
+        return;
+
+    for (size_t i = (first > 0) ? first - 1 : 0; i + 1 < children.size(); ++i)
+    {
+        children[i]->next_ = children[i + 1];
+        children[i + 1]->prev_ = children[i];
+    }
+    children.back()->next_ = children.front();
+    children.front()->prev_ = children.back();
+    generation_++;
+}
+
+/**
+ * Delete all children in this node and release their storage.
+ */
+void MenuNode::clearNodes()
+{
+    deleteNodes(children);
     children.clear();
+    generation_++;
 }
 
 bool MenuNode::up(NaviEngine& navi)
@@ -220,6 +333,53 @@ bool MenuNode::abort()
     return true;
 }
 
+/**
+ * Get a number that changes whenever children are added or removed.
+ *
+ * @return The generation of the children of this node.
+ */
+unsigned int MenuNode::childrenGeneration() const
+{
+    return generation_;
+}
+
+/**
+ * Get the approximate memory held by this node, not counting its children.
+ *
+ * @return The approximate number of bytes held by this node.
+ */
+size_t MenuNode::memoryUsage() const
+{
+    return sizeof(*this) + name_.capacity() + info_.capacity() + uri_.capacity()
+            + children.heapBytes();
+}
+
+/**
+ * Let the memory budget of NaviEngine delete the children of this node.
+ *
+ * Only enable this for nodes whose onOpen adds the children again when the
+ * node has none, as the children are deleted by evict.
+ *
+ * @param evictable If true, evict deletes the children, otherwise it keeps them.
+ */
+void MenuNode::setEvictable(bool evictable)
+{
+    evictable_ = evictable;
+}
+
+/**
+ * Delete the children of this node if it is evictable, see setEvictable.
+ *
+ * @return true if the children were deleted, otherwise false.
+ */
+bool MenuNode::evict()
+{
+    if (not evictable_ || children.empty())
+        return false;
+    clearNodes();
+    return true;
+}
+
 /**
  * Get number of children in this node.
  *
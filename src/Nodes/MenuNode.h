@@ -21,6 +21,7 @@
 #define NAVIENGINE_MENUNODE
 
 #include "AnyNode.h"
+#include "ChildList.h"
 
 #include <vector>
 #include <string>
@@ -28,6 +29,7 @@
 namespace naviengine
 {
 class NaviEngine;
+class MenuViewNode;
 
 /**
  * A menu node, can have children of AnyNode type
@@ -39,9 +41,13 @@ public:
     ~MenuNode();
     AnyNode* firstChild() const;
     AnyNode* lastChild();
+    AnyNode* childAt(int index) const;
+    int indexOf(const AnyNode* child) const;
 
     void clearNodes();
+    void setEvictable(bool evictable);
     void addNode(AnyNode* node);
+    void addNodes(const std::vector<AnyNode*>& nodes);
     bool up(NaviEngine& navi);
     bool prev(NaviEngine& navi);
     bool next(NaviEngine& navi);
@@ -58,10 +64,22 @@ public:
     bool process(NaviEngine&, int command, void* data = 0);
     bool abort();
 
+    unsigned int childrenGeneration() const;
+    size_t memoryUsage() const;
+    bool evict();
+
     int numberOfChildren();
 
 private:
-    std::vector<AnyNode*> children;
+    friend class MenuViewNode;
+    static void deleteNodes(const ChildList& nodes);
+
+    ChildList children;
+    /** The views of this node, told when it is deleted */
+    MenuViewNode* views_;
+    unsigned int generation_;
+    /** True if onOpen builds the children again after they are evicted */
+    bool evictable_;
 };
 }
 #endif
@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MenuViewNode.h"
+#include "NaviEngine.h"
+
+#include <sstream>
+
+using namespace naviengine;
+
+/**
+ * Constructor.
+ *
+ * Generates a unique uri for this node and shows all children of the source.
+ *
+ * @param source The menu node whose children are shown, not owned by the view.
+ * @param name The name of this node.
+ */
+MenuViewNode::MenuViewNode(MenuNode* source, const std::string& name) :
+        source_(source), nextView_(NULL), sourceGeneration_(0), generation_(0)
+{
+    name_ = name;
+    if (source_ != NULL)
+    {
+        nextView_ = source_->views_;
+        source_->views_ = this;
+    }
+
+    std::ostringstream uri_from_anything;
+    uri_from_anything << id_;
+    uri_ = uri_from_anything.str();
+
+    showAll();
+}
+
+/**
+ * Destructor.
+ *
+ * The source and its children are left alone.
+ */
+MenuViewNode::~MenuViewNode()
+{
+    if (source_ == NULL)
+        return;
+    MenuViewNode** link = &source_->views_;
+    while (*link != this)
+        link = &(*link)->nextView_;
+    *link = nextView_;
+}
+
+/**
+ * Get the first shown child.
+ *
+ * @return A pointer to the first shown child, or NULL if none is shown.
+ */
+AnyNode* MenuViewNode::firstChild() const
+{
+    return childAt(0);
+}
+
+/**
+ * Get a shown child by its position in the view.
+ *
+ * @param index The position in the view, starting from 0.
+ * @return A pointer to the child, or NULL if there is no such child.
+ */
+AnyNode* MenuViewNode::childAt(int index) const
+{
+    refresh();
+    if (index < 0 || index >= (int) indices_.size())
+        return NULL;
+    return source_->childAt(indices_[index]);
+}
+
+/**
+ * Get the menu node whose children are shown.
+ *
+ * @return A pointer to the source, or NULL if it has been deleted.
+ */
+MenuNode* MenuViewNode::source() const
+{
+    return source_;
+}
+
+/**
+ * Show all children of the source in their own order.
+ */
+void MenuViewNode::showAll()
+{
+    reset();
+}
+
+/**
+ * Show all children again if the children of the source have changed, or
+ * none if the source has been deleted.
+ */
+void MenuViewNode::refresh() const
+{
+    if (source_ == NULL ? not indices_.empty() : source_->childrenGeneration() != sourceGeneration_)
+        reset();
+}
+
+/**
+ * Show all children of the source in their own order.
+ */
+void MenuViewNode::reset() const
+{
+    int count = (source_ != NULL) ? source_->numberOfChildren() : 0;
+    indices_.resize(count);
+    for (int i = 0; i < count; ++i)
+        indices_[i] = i;
+    sourceGeneration_ = (source_ != NULL) ? source_->childrenGeneration() : 0;
+    reindex();
+}
+
+/**
+ * Map the positions in the source to the positions in the view again.
+ */
+void MenuViewNode::reindex() const
+{
+    positions_.assign((source_ != NULL) ? source_->numberOfChildren() : 0, -1);
+    for (size_t i = 0; i < indices_.size(); ++i)
+        positions_[indices_[i]] = i;
+    generation_++;
+}
+
+/**
+ * Get the position of a child in the view.
+ *
+ * @param child The child to look for.
+ * @return The position in the view, or -1 if the child is not shown.
+ */
+int MenuViewNode::indexOf(const AnyNode* child) const
+{
+    refresh();
+    if (source_ == NULL)
+        return -1;
+    int position = source_->indexOf(child);
+    if (position < 0 || position >= (int) positions_.size())
+        return -1;
+    return positions_[position];
+}
+
+/**
+ * Get the position of the current choice in the view.
+ *
+ * The current child is checked against the choice, and the choice is looked
+ * up if the view has changed since it was set.
+ *
+ * @return The position, or -1 if the choice is not shown.
+ */
+int MenuViewNode::currentIndex(NaviEngine& navi)
+{
+    refresh();
+    int index = navi.getCurrentChild();
+    AnyNode* choice = navi.getCurrentChoice();
+    if (choice != NULL && choice != childAt(index))
+        index = indexOf(choice);
+    return index;
+}
+
+bool MenuViewNode::up(NaviEngine& navi)
+{
+    navi.setCurrentNode(this->parent_);
+    navi.setCurrentChoice(this);
+
+    if (parent_ == 0)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool MenuViewNode::prev(NaviEngine& navi)
+{
+    int index = currentIndex(navi) - 1;
+    if (indices_.empty())
+        return false;
+
+    if (index < 0 || index >= (int) indices_.size())
+        index = indices_.size() - 1;
+    navi.setCurrentChild(index);
+    navi.setCurrentChoice(childAt(index));
+    return true;
+}
+
+bool MenuViewNode::next(NaviEngine& navi)
+{
+    int index = currentIndex(navi) + 1;
+    if (indices_.empty())
+        return false;
+
+    if (index < 0 || index >= (int) indices_.size())
+        index = 0;
+    navi.setCurrentChild(index);
+    navi.setCurrentChoice(childAt(index));
+    return true;
+}
+
+bool MenuViewNode::select(NaviEngine& navi)
+{
+    if (navi.getCurrentChoice() != NULL)
+    {
+        navi.setCurrentNode(navi.getCurrentChoice());
+        navi.setCurrentChoice(navi.getCurrentChoice()->firstChild());
+        return true;
+    }
+    return false;
+}
+
+bool MenuViewNode::selectByUri(NaviEngine& /* navi */, std::string /* uri */)
+{
+    return false;
+}
+
+bool MenuViewNode::menu(NaviEngine& /* navi */)
+{
+    return false;
+}
+
+/**
+ * Keep the current choice in the view.
+ *
+ * If the children of the source have changed since the view was last reset,
+ * all children are shown again. Subclasses that sort or filter should do so
+ * before calling this.
+ */
+bool MenuViewNode::onOpen(NaviEngine& navi)
+{
+    int index = (navi.getCurrentChoice() != NULL) ? currentIndex(navi) : 0;
+    if (index < 0)
+        index = 0;
+    navi.setCurrentChild(index);
+    navi.setCurrentChoice(childAt(index));
+    return true;
+}
+
+void MenuViewNode::beforeOnOpen()
+{
+}
+
+bool MenuViewNode::narrateName()
+{
+    return false;
+}
+
+bool MenuViewNode::narrateInfo()
+{
+    return false;
+}
+
+bool MenuViewNode::onNarrate()
+{
+    return false;
+}
+
+bool MenuViewNode::onRender()
+{
+    return false;
+}
+
+bool MenuViewNode::isVirtual()
+{
+    return false;
+}
+
+bool MenuViewNode::process(NaviEngine& /* navi */, int /* command */, void* /* data */)
+{
+    return false;
+}
+
+bool MenuViewNode::abort()
+{
+    return true;
+}
+
+/**
+ * Get a number that changes whenever the view is sorted, filtered or reset.
+ *
+ * @return The generation of the view.
+ */
+unsigned int MenuViewNode::childrenGeneration() const
+{
+    return generation_;
+}
+
+/**
+ * Get the memory held by the view, not counting the shown children.
+ *
+ * @return The approximate number of bytes held by this node.
+ */
+size_t MenuViewNode::memoryUsage() const
+{
+    return sizeof(*this) + name_.capacity() + info_.capacity() + uri_.capacity()
+            + (indices_.capacity() + positions_.capacity()) * sizeof(int);
+}
+
+/**
+ * Get the number of shown children.
+ *
+ * @return Number of shown children.
+ */
+int MenuViewNode::numberOfChildren()
+{
+    refresh();
+    return indices_.size();
+}
+
+/**
+ * Get the position of the current choice in the view.
+ *
+ * @return The position starting from 1, or 0 if the choice is not in the view.
+ */
+int MenuViewNode::currentPosition(NaviEngine& navi)
+{
+    if (navi.getCurrentChoice() == NULL)
+        return 0;
+    return currentIndex(navi) + 1;
+}
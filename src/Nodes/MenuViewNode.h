@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAVIENGINE_MENUVIEWNODE
+#define NAVIENGINE_MENUVIEWNODE
+
+#include "AnyNode.h"
+#include "MenuNode.h"
+
+#include <algorithm>
+#include <vector>
+#include <string>
+
+namespace naviengine
+{
+class NaviEngine;
+
+/**
+ * A sorted or filtered view of the children of a menu node
+ *
+ * The view shows the children of its source without copying them. It only
+ * keeps the positions of the shown children, so sorting and filtering a
+ * large menu allocates nothing per child. The source is not owned by the
+ * view, when it is deleted the view shows no children. Going up from a
+ * child opened through the view returns to the view, see
+ * NaviEngine::up. When the children of the source change, the view shows
+ * all of them again.
+ *
+ * The engine keeps the position of the choice in the view as the current
+ * child, see NaviEngine::selection_type.
+ */
+class MenuViewNode: public AnyNode
+{
+public:
+    MenuViewNode(MenuNode* source, const std::string& name = "");
+    ~MenuViewNode();
+    AnyNode* firstChild() const;
+    AnyNode* childAt(int index) const;
+    MenuNode* source() const;
+    int indexOf(const AnyNode* child) const;
+
+    void showAll();
+
+    /**
+     * Show only the children of the source matching a predicate
+     *
+     * The children keep the order they had in the view.
+     *
+     * @param predicate A function or functor taking a const AnyNode*
+     */
+    template<typename Predicate>
+    void filter(Predicate predicate)
+    {
+        refresh();
+        std::vector<int>::iterator last = indices_.begin();
+        for (std::vector<int>::iterator it = indices_.begin(); it != indices_.end(); ++it)
+        {
+            if (predicate(static_cast<const AnyNode*>(source_->childAt(*it))))
+                *last++ = *it;
+        }
+        indices_.erase(last, indices_.end());
+        reindex();
+    }
+
+    /**
+     * Sort the shown children
+     *
+     * @param compare A function or functor comparing two const AnyNode*
+     */
+    template<typename Compare>
+    void sort(Compare compare)
+    {
+        refresh();
+        std::stable_sort(indices_.begin(), indices_.end(), ByChild<Compare>(source_, compare));
+        reindex();
+    }
+
+    bool up(NaviEngine& navi);
+    bool prev(NaviEngine& navi);
+    bool next(NaviEngine& navi);
+    bool select(NaviEngine& navi);
+    bool selectByUri(NaviEngine& navi, std::string uri);
+    bool menu(NaviEngine& navi);
+    bool onOpen(NaviEngine& navi);
+    void beforeOnOpen();
+    bool narrateName();
+    bool narrateInfo();
+    bool onNarrate();
+    bool onRender();
+    bool isVirtual();
+    bool process(NaviEngine&, int command, void* data = 0);
+    bool abort();
+
+    unsigned int childrenGeneration() const;
+    size_t memoryUsage() const;
+
+    int numberOfChildren();
+    int currentPosition(NaviEngine& navi);
+
+private:
+    void refresh() const;
+    void reset() const;
+    void reindex() const;
+    int currentIndex(NaviEngine& navi);
+
+    /** Compares positions in the source by the children at them */
+    template<typename Compare>
+    struct ByChild
+    {
+        ByChild(const MenuNode* source, Compare compare) :
+                source_(source), compare_(compare)
+        {
+        }
+
+        bool operator()(int a, int b)
+        {
+            return compare_(static_cast<const AnyNode*>(source_->childAt(a)),
+                    static_cast<const AnyNode*>(source_->childAt(b)));
+        }
+
+        const MenuNode* source_;
+        Compare compare_;
+    };
+
+    friend class MenuNode;
+
+    /** The menu node whose children are shown, NULL once it has been deleted */
+    MenuNode* source_;
+    /** The next view of the same source */
+    MenuViewNode* nextView_;
+    /** Positions in the source of the shown children, in view order */
+    mutable std::vector<int> indices_;
+    /** Positions in the view by position in the source, -1 if not shown */
+    mutable std::vector<int> positions_;
+    /** Children generation of the source when the view was last reset */
+    mutable unsigned int sourceGeneration_;
+    mutable unsigned int generation_;
+};
+}
+#endif
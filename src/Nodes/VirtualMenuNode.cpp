@@ -20,8 +20,31 @@
 #include "VirtualMenuNode.h"
 #include "NaviEngine.h"
 
+#include <algorithm>
+
 using namespace naviengine;
 
+namespace
+{
+/**
+ * Remove the entry of a position from an index of the children
+ */
+template<typename Index>
+void eraseEntry(Index& index, const typename Index::key_type& key, size_t position)
+{
+    typedef typename Index::iterator Iterator;
+    std::pair<Iterator, Iterator> range = index.equal_range(key);
+    for (Iterator it = range.first; it != range.second; ++it)
+    {
+        if (it->second == position)
+        {
+            index.erase(it);
+            return;
+        }
+    }
+}
+}
+
 /**
  * Constructor.
  *
@@ -29,14 +52,14 @@ using namespace naviengine;
  *
  * @param name The name of this node.
  */
-VirtualMenuNode::VirtualMenuNode(const std::string& name)
+VirtualMenuNode::VirtualMenuNode(const std::string& name) :
+        indexed_(0), childBytes_(0), evictable_(false)
 {
     name_ = name;
 
     std::ostringstream uri_from_anything;
-    uri_from_anything << reinterpret_cast<long>(this);
+    uri_from_anything << id_;
     uri_ = uri_from_anything.str();
-    currentChild = 0;
 }
 
 /**
@@ -51,14 +74,260 @@ AnyNode* VirtualMenuNode::firstChild() const
     return NULL;
 }
 
-bool VirtualMenuNode::select(NaviEngine& navi)
+bool VirtualMenuNode::select(NaviEngine& /* navi */)
 {
     return false;
 }
 
+/**
+ * Add a virtual child.
+ *
+ * @param child The child to add.
+ */
+void VirtualMenuNode::addChild(const VirtualNode& child)
+{
+    if (indexed_ != children.size())
+        reindex();
+    children.push_back(child);
+    indexFrom(indexed_);
+}
+
+/**
+ * Replace a virtual child.
+ *
+ * @param index The position of the child to replace.
+ * @param child The new child.
+ */
+void VirtualMenuNode::setChild(size_t index, const VirtualNode& child)
+{
+    if (index >= children.size())
+        return;
+
+    if (indexed_ != children.size())
+        reindex();
+
+    eraseEntry(uriIndex_, hashUri(children[index].uri_), index);
+    eraseEntry(idIndex_, children[index].id_, index);
+    childBytes_ -= childBytes(children[index]);
+    childBytes_ += childBytes(child);
+    children[index] = child;
+    uriIndex_.insert(std::make_pair(hashUri(child.uri_), index));
+    idIndex_.insert(std::make_pair(child.id_, index));
+}
+
+/**
+ * Remove all virtual children.
+ */
+void VirtualMenuNode::clearChildren()
+{
+    std::vector<VirtualNode>().swap(children);
+    uriIndex_.clear();
+    idIndex_.clear();
+    indexed_ = 0;
+    childBytes_ = 0;
+}
+
+/**
+ * Let the memory budget of NaviEngine release the virtual children.
+ *
+ * Only enable this for nodes whose onOpen adds the children again when the
+ * node has none, as the children are cleared by evict.
+ *
+ * @param evictable If true, evict clears the children, otherwise it keeps them.
+ */
+void VirtualMenuNode::setEvictable(bool evictable)
+{
+    evictable_ = evictable;
+}
+
+/**
+ * Clear the virtual children if the node is evictable, see setEvictable.
+ *
+ * @return true if the children were cleared, otherwise false.
+ */
+bool VirtualMenuNode::evict()
+{
+    if (not evictable_ || children.empty())
+        return false;
+    clearChildren();
+    return true;
+}
+
+/**
+ * Get the position of the first virtual child with a uri.
+ *
+ * Only reads the node, so engines sharing the node can look up children
+ * concurrently.
+ *
+ * @param uri The uri to look for.
+ * @return The position of the child, or -1 if no child has the uri.
+ */
+int VirtualMenuNode::indexOfUri(const std::string& uri) const
+{
+    size_t indexed = std::min(indexed_, children.size());
+    size_t found = indexed;
+
+    typedef std::tr1::unordered_multimap<size_t, size_t>::const_iterator Iterator;
+    std::pair<Iterator, Iterator> range = uriIndex_.equal_range(hashUri(uri));
+    for (Iterator it = range.first; it != range.second; ++it)
+    {
+        if (it->second < found && children[it->second].uri_ == uri)
+            found = it->second;
+    }
+    if (found < indexed)
+        return found;
+
+    // Children appended directly to the vector are not indexed yet
+    for (size_t i = indexed; i < children.size(); ++i)
+    {
+        if (children[i].uri_ == uri)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Get the position of the first virtual child with an id.
+ *
+ * Only reads the node, so engines sharing the node can look up children
+ * concurrently.
+ *
+ * @param id The id to look for.
+ * @return The position of the child, or -1 if no child has the id.
+ */
+int VirtualMenuNode::indexOfId(uint64_t id) const
+{
+    size_t indexed = std::min(indexed_, children.size());
+    size_t found = indexed;
+
+    typedef std::tr1::unordered_multimap<uint64_t, size_t>::const_iterator Iterator;
+    std::pair<Iterator, Iterator> range = idIndex_.equal_range(id);
+    for (Iterator it = range.first; it != range.second; ++it)
+    {
+        if (it->second < found && children[it->second].id_ == id)
+            found = it->second;
+    }
+    if (found < indexed)
+        return found;
+
+    // Children appended directly to the vector are not indexed yet
+    for (size_t i = indexed; i < children.size(); ++i)
+    {
+        if (children[i].id_ == id)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Get the id of a virtual child.
+ *
+ * @param index The position of the child.
+ * @return The id of the child, or 0 if there is no such child.
+ */
+uint64_t VirtualMenuNode::childId(int index) const
+{
+    if (index < 0 || index >= (int) children.size())
+        return 0;
+    return children[index].id_;
+}
+
+/**
+ * Get the uri of a virtual child.
+ *
+ * @param index The position of the child.
+ * @return The uri of the child, or an empty string if there is no such child.
+ */
+std::string VirtualMenuNode::childUri(int index) const
+{
+    if (index < 0 || index >= (int) children.size())
+        return std::string();
+    return children[index].uri_;
+}
+
+/**
+ * Index all virtual children by uri and id again.
+ *
+ * Needed after children have been replaced or removed directly in the vector.
+ */
+void VirtualMenuNode::reindex()
+{
+    uriIndex_.clear();
+    idIndex_.clear();
+    childBytes_ = 0;
+    indexFrom(0);
+}
+
+/**
+ * Add children to the uri and id indexes.
+ *
+ * @param first The position of the first child to add.
+ */
+void VirtualMenuNode::indexFrom(size_t first)
+{
+    for (size_t i = first; i < children.size(); ++i)
+    {
+        uriIndex_.insert(std::make_pair(hashUri(children[i].uri_), i));
+        idIndex_.insert(std::make_pair(children[i].id_, i));
+        childBytes_ += childBytes(children[i]);
+    }
+    indexed_ = children.size();
+}
+
+/**
+ * Hash a uri for the uri index.
+ *
+ * @param uri The uri.
+ * @return The hash of the uri.
+ */
+size_t VirtualMenuNode::hashUri(const std::string& uri)
+{
+    return std::tr1::hash<std::string>()(uri);
+}
+
+/**
+ * Get the bytes held by the strings of a virtual child.
+ *
+ * @param child The child.
+ * @return The approximate number of bytes.
+ */
+size_t VirtualMenuNode::childBytes(const VirtualNode& child)
+{
+    return child.name_.capacity() + child.info_.capacity() + child.uri_.capacity();
+}
+
+/**
+ * Make the virtual child with a uri the current child.
+ *
+ * @param navi The engine navigating this node.
+ * @param uri The uri of the child.
+ * @return true if a child has the uri, otherwise false.
+ */
 bool VirtualMenuNode::selectByUri(NaviEngine& navi, std::string uri)
 {
-    return false;
+    int index = indexOfUri(uri);
+    if (index < 0)
+        return false;
+
+    navi.setCurrentChild(index);
+    return true;
+}
+
+/**
+ * Make the virtual child with an id the current child.
+ *
+ * @param navi The engine navigating this node.
+ * @param id The id of the child.
+ * @return true if a child has the id, otherwise false.
+ */
+bool VirtualMenuNode::selectById(NaviEngine& navi, uint64_t id)
+{
+    int index = indexOfId(id);
+    if (index < 0)
+        return false;
+
+    navi.setCurrentChild(index);
+    return true;
 }
 
 bool VirtualMenuNode::up(NaviEngine& navi)
@@ -76,26 +345,31 @@ bool VirtualMenuNode::up(NaviEngine& navi)
 
 bool VirtualMenuNode::next(NaviEngine& navi)
 {
-    currentChild++;
-    currentChild %= children.size();
+    if (children.empty())
+        return false;
+
+    navi.setCurrentChild((navi.getCurrentChild() + 1) % children.size());
     return true;
 }
 
 bool VirtualMenuNode::prev(NaviEngine& navi)
 {
-    if (currentChild == 0)
-        currentChild = children.size() - 1;
+    if (children.empty())
+        return false;
+
+    if (navi.getCurrentChild() == 0)
+        navi.setCurrentChild(children.size() - 1);
     else
-        currentChild--;
+        navi.setCurrentChild(navi.getCurrentChild() - 1);
     return true;
 }
 
-bool VirtualMenuNode::menu(NaviEngine& navi)
+bool VirtualMenuNode::menu(NaviEngine& /* navi */)
 {
     return false;
 }
 
-bool VirtualMenuNode::onOpen(NaviEngine& navi)
+bool VirtualMenuNode::onOpen(NaviEngine& /* navi */)
 {
     return true;
 }
@@ -129,7 +403,7 @@ bool VirtualMenuNode::isVirtual()
     return true;
 }
 
-bool VirtualMenuNode::process(NaviEngine& navi, int command, void* data)
+bool VirtualMenuNode::process(NaviEngine& /* navi */, int /* command */, void* /* data */)
 {
     return false;
 }
@@ -139,6 +413,27 @@ bool VirtualMenuNode::abort()
     return true;
 }
 
+/**
+ * Get the approximate memory held by this node and its virtual children.
+ *
+ * The children are counted as they are added, so this does not walk them.
+ *
+ * @return The approximate number of bytes held by this node.
+ */
+size_t VirtualMenuNode::memoryUsage() const
+{
+    size_t bytes = sizeof(*this) + name_.capacity() + info_.capacity() + uri_.capacity()
+            + children.capacity() * sizeof(VirtualNode) + childBytes_;
+    // Children appended directly to the vector are not counted yet
+    for (size_t i = std::min(indexed_, children.size()); i < children.size(); ++i)
+        bytes += childBytes(children[i]);
+    bytes += uriIndex_.size() * (sizeof(std::pair<size_t, size_t>) + sizeof(void*))
+            + uriIndex_.bucket_count() * sizeof(void*);
+    bytes += idIndex_.size() * (sizeof(std::pair<uint64_t, size_t>) + sizeof(void*))
+            + idIndex_.bucket_count() * sizeof(void*);
+    return bytes;
+}
+
 /**
  * Get number of children in this node.
  *
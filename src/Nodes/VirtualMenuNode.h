@@ -25,6 +25,7 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <tr1/unordered_map>
 
 namespace naviengine
 {
@@ -39,18 +40,20 @@ struct VirtualNode
     std::string name_;
     std::string info_;
     std::string uri_;
+    /** Id assigned at creation, kept by copies */
+    uint64_t id_;
 
-    VirtualNode(std::string name, std::string info) : name_(name), info_(info)
+    VirtualNode(std::string name, std::string info) : name_(name), info_(info), id_(AnyNode::nextId())
     {
         std::ostringstream uri_from_anything;
-        uri_from_anything << reinterpret_cast<long>(this);
+        uri_from_anything << id_;
         uri_ = uri_from_anything.str() + "_" + name_;
     }
 
-    VirtualNode(std::string name) : name_(name), info_("")
+    VirtualNode(std::string name) : name_(name), info_(""), id_(AnyNode::nextId())
     {
         std::ostringstream uri_from_anything;
-        uri_from_anything << reinterpret_cast<long>(this);
+        uri_from_anything << id_;
         uri_ = uri_from_anything.str() + "_" + name_;
     }
 };
@@ -65,8 +68,19 @@ public:
     ~VirtualMenuNode();
     AnyNode* firstChild() const;
 
+    void addChild(const VirtualNode& child);
+    void setChild(size_t index, const VirtualNode& child);
+    void clearChildren();
+    void setEvictable(bool evictable);
+    int indexOfUri(const std::string& uri) const;
+    int indexOfId(uint64_t id) const;
+    uint64_t childId(int index) const;
+    std::string childUri(int index) const;
+    void reindex();
+
     bool select(NaviEngine& navi);
     bool selectByUri(NaviEngine& navi, std::string uri);
+    bool selectById(NaviEngine& navi, uint64_t id);
     bool up(NaviEngine& navi);
     bool next(NaviEngine& navi);
     bool prev(NaviEngine& navi);
@@ -81,13 +95,36 @@ public:
     bool process(NaviEngine&, int command, void* data = 0);
     bool abort();
 
+    size_t memoryUsage() const;
+    bool evict();
+
     int numberOfChildren();
 
 public:
-    /** Vector holding the virtual children */
+    /**
+     * Vector holding the virtual children, the current child is kept by NaviEngine.
+     * Use addChild, setChild and clearChildren to keep the uri and id indexes
+     * up to date. Children appended directly are found by a linear search until
+     * the next call to addChild or reindex, children replaced or removed
+     * directly need a call to reindex.
+     */
     std::vector<VirtualNode> children;
-    /** Variable holding the current child */
-    int currentChild;
+
+private:
+    void indexFrom(size_t first);
+    static size_t hashUri(const std::string& uri);
+    static size_t childBytes(const VirtualNode& child);
+
+    /** Positions of the children by the hash of their uri */
+    std::tr1::unordered_multimap<size_t, size_t> uriIndex_;
+    /** Positions of the children by their id, copies of a child share it */
+    std::tr1::unordered_multimap<uint64_t, size_t> idIndex_;
+    /** Number of children in the uri and id indexes */
+    size_t indexed_;
+    /** Bytes held by the strings of the indexed children */
+    size_t childBytes_;
+    /** True if onOpen adds the children again after they are evicted */
+    bool evictable_;
 };
 }
 #endif
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "OpenCompletions.h"
+
+using namespace naviengine;
+
+/**
+ * Constructor
+ */
+OpenCompletions::OpenCompletions()
+{
+    pthread_mutex_init(&mutex_, NULL);
+}
+
+/**
+ * Destructor
+ */
+OpenCompletions::~OpenCompletions()
+{
+    pthread_mutex_destroy(&mutex_);
+}
+
+/**
+ * Queue a completed open, safe to call from any thread
+ *
+ * @param ticket The ticket of the completed open
+ */
+void OpenCompletions::add(unsigned long ticket)
+{
+    pthread_mutex_lock(&mutex_);
+    tickets_.push_back(ticket);
+    pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Take all queued completions
+ *
+ * @param tickets Filled with the tickets in the order they were completed
+ * @return true if any completion was queued, otherwise false
+ */
+bool OpenCompletions::take(std::vector<unsigned long>& tickets)
+{
+    tickets.clear();
+    pthread_mutex_lock(&mutex_);
+    tickets.swap(tickets_);
+    pthread_mutex_unlock(&mutex_);
+    return not tickets.empty();
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAVIENGINE_OPENCOMPLETIONS
+#define NAVIENGINE_OPENCOMPLETIONS
+
+#include <vector>
+#include <pthread.h>
+
+namespace naviengine
+{
+
+/**
+ * OpenCompletions passes completed asynchronous opens to the engine thread.
+ *
+ * Any thread may add the ticket of an open it has finished. The engine takes
+ * all queued tickets when it delivers completions on its own thread.
+ */
+class OpenCompletions
+{
+public:
+    OpenCompletions();
+    ~OpenCompletions();
+
+    void add(unsigned long ticket);
+    bool take(std::vector<unsigned long>& tickets);
+
+private:
+    pthread_mutex_t mutex_;
+    std::vector<unsigned long> tickets_;
+};
+}
+#endif
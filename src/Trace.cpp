@@ -0,0 +1,373 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Trace.h"
+#include "Nodes/AnyNode.h"
+
+#include <fstream>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace naviengine
+{
+/**
+ * A traced command or hook
+ */
+struct TraceEvent
+{
+    const char* name;
+    /** The start and duration in ticks, converted to nanoseconds when written */
+    uint64_t start;
+    uint64_t duration;
+    int depth;
+    int menus;
+    char uri[40];
+};
+
+/**
+ * The events of one thread. Only the thread itself writes to its buffer.
+ */
+struct TraceBuffer
+{
+    /** Number of the thread in the trace, starting from 1 */
+    int thread;
+    TraceEvent* events;
+    size_t capacity;
+    /** Number of events written, the latest capacity of them are kept */
+    size_t head;
+    /** Number of open scopes in the thread */
+    int depth;
+    /** The session the events are written for */
+    unsigned int session;
+    /** Set when the thread has ended, the buffer is freed when tracing is enabled again */
+    bool ended;
+    TraceBuffer* next;
+};
+}
+
+using namespace naviengine;
+
+namespace
+{
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+/** All buffers, kept after their threads have ended so their events can be written */
+TraceBuffer* buffers = NULL;
+int threads = 0;
+size_t capacity = 65536;
+/** Events from before tracing was last enabled are not written, in ticks */
+uint64_t sessionStart = 0;
+/** The monotonic time tracing was last enabled, in nanoseconds */
+uint64_t sessionStartTime = 0;
+/** Counts the times tracing has been enabled */
+unsigned int session = 0;
+__thread TraceBuffer* local = NULL;
+pthread_once_t keyOnce = PTHREAD_ONCE_INIT;
+/** Marks the buffer of a thread as ended when the thread exits */
+pthread_key_t endKey;
+
+void threadEnded(void* buffer)
+{
+    pthread_mutex_lock(&mutex);
+    static_cast<TraceBuffer*>(buffer)->ended = true;
+    pthread_mutex_unlock(&mutex);
+}
+
+void createKey()
+{
+    pthread_key_create(&endKey, threadEnded);
+}
+
+/** Write a time in nanoseconds as microseconds */
+void writeMicroseconds(std::ostream& out, uint64_t nanoseconds)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%llu.%03u", (unsigned long long) (nanoseconds / 1000),
+            (unsigned int) (nanoseconds % 1000));
+    out << text;
+}
+
+/** Write a string as a JSON string */
+void writeString(std::ostream& out, const char* text)
+{
+    out << '"';
+    for (const char* c = text; *c != '\0'; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            out << '\\' << *c;
+        }
+        else if ((unsigned char) *c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned int) (unsigned char) *c);
+            out << escaped;
+        }
+        else
+        {
+            out << *c;
+        }
+    }
+    out << '"';
+}
+}
+
+volatile bool Trace::enabled_ = false;
+
+/**
+ * Start tracing
+ *
+ * Events from before this call are dropped. The buffers of threads that have
+ * ended are freed, other threads resize theirs when they trace next.
+ *
+ * @param eventsPerThread The number of latest events to keep for each thread
+ */
+void Trace::enable(size_t eventsPerThread)
+{
+    pthread_mutex_lock(&mutex);
+    capacity = (eventsPerThread > 0) ? eventsPerThread : 1;
+    sessionStartTime = now();
+    sessionStart = ticks();
+    __atomic_store_n(&session, session + 1, __ATOMIC_RELEASE);
+
+    TraceBuffer** link = &buffers;
+    while (*link != NULL)
+    {
+        TraceBuffer* buffer = *link;
+        if (buffer->ended)
+        {
+            *link = buffer->next;
+            delete[] buffer->events;
+            delete buffer;
+        }
+        else
+        {
+            link = &buffer->next;
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+    enabled_ = true;
+}
+
+/**
+ * Stop tracing
+ *
+ * The events are kept until tracing is enabled again.
+ */
+void Trace::disable()
+{
+    enabled_ = false;
+}
+
+/**
+ * Check if tracing is enabled
+ *
+ * @return true if enabled, otherwise false
+ */
+bool Trace::enabled()
+{
+    return enabled_;
+}
+
+/**
+ * Get the buffer of the calling thread, creating it on first use
+ */
+TraceBuffer* Trace::buffer()
+{
+    TraceBuffer* buffer = local;
+    if (buffer != NULL && buffer->session == __atomic_load_n(&session, __ATOMIC_ACQUIRE))
+        return buffer;
+    return renew(buffer);
+}
+
+/**
+ * Create the buffer of the calling thread, or empty it for a new session
+ *
+ * @param buffer The buffer of the thread, or NULL if it has none
+ */
+TraceBuffer* Trace::renew(TraceBuffer* buffer)
+{
+    pthread_once(&keyOnce, createKey);
+    pthread_mutex_lock(&mutex);
+    if (buffer == NULL)
+    {
+        buffer = new TraceBuffer;
+        buffer->events = NULL;
+        buffer->capacity = 0;
+        buffer->depth = 0;
+        buffer->ended = false;
+        buffer->thread = ++threads;
+        buffer->next = buffers;
+        buffers = buffer;
+        pthread_setspecific(endKey, buffer);
+        local = buffer;
+    }
+    if (buffer->capacity != capacity)
+    {
+        delete[] buffer->events;
+        buffer->capacity = capacity;
+        buffer->events = new TraceEvent[capacity];
+    }
+    buffer->head = 0;
+    buffer->session = session;
+    pthread_mutex_unlock(&mutex);
+    return buffer;
+}
+
+/**
+ * Get a monotonic time in nanoseconds
+ */
+uint64_t Trace::now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+/**
+ * Get a count of ticks that increases at a constant rate
+ *
+ * Reads the time stamp counter where there is one, which costs about half of
+ * a read of the monotonic clock. The counter runs at a constant rate and is
+ * synchronized between cores on processors from the last decade. Elsewhere
+ * the ticks are nanoseconds of the monotonic clock.
+ */
+inline uint64_t Trace::ticks()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    return __rdtsc();
+#else
+    return now();
+#endif
+}
+
+/**
+ * Write the events of all threads as Chrome trace event JSON
+ *
+ * The ticks of the events are converted to nanoseconds at the rate measured
+ * since tracing was enabled. Writing waits until that has been at least a
+ * millisecond, so the rate is measured precisely enough.
+ *
+ * @param out The stream to write to
+ */
+void Trace::write(std::ostream& out)
+{
+    pthread_mutex_lock(&mutex);
+    uint64_t elapsed = now() - sessionStartTime;
+    if (elapsed < 1000000)
+    {
+        struct timespec remaining = { 0, (long) (1000000 - elapsed) };
+        nanosleep(&remaining, NULL);
+    }
+    uint64_t endTime = now();
+    uint64_t endTicks = ticks();
+    double rate = (endTicks > sessionStart) ? double(endTime - sessionStartTime) / (endTicks - sessionStart) : 1.0;
+
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (TraceBuffer* buffer = buffers; buffer != NULL; buffer = buffer->next)
+    {
+        size_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+        size_t count = (head < buffer->capacity) ? head : buffer->capacity;
+        for (size_t i = head - count; i < head; ++i)
+        {
+            const TraceEvent& event = buffer->events[i % buffer->capacity];
+            if (event.start < sessionStart)
+                continue;
+
+            out << (first ? "\n" : ",\n") << "{\"name\":";
+            writeString(out, event.name);
+            out << ",\"cat\":\"naviengine\",\"ph\":\"X\",\"ts\":";
+            writeMicroseconds(out, sessionStartTime + (uint64_t) ((event.start - sessionStart) * rate));
+            out << ",\"dur\":";
+            writeMicroseconds(out, (uint64_t) (event.duration * rate + 0.5));
+            out << ",\"pid\":1,\"tid\":" << buffer->thread << ",\"args\":{\"uri\":";
+            writeString(out, event.uri);
+            out << ",\"menus\":" << event.menus << ",\"nesting\":" << event.depth << "}}";
+            first = false;
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    pthread_mutex_unlock(&mutex);
+}
+
+/**
+ * Write the events of all threads as Chrome trace event JSON to a file
+ *
+ * @param path The file to write
+ * @return true on success, otherwise false
+ */
+bool Trace::write(const std::string& path)
+{
+    std::ofstream out(path.c_str());
+    if (not out)
+        return false;
+    write(out);
+    out.close();
+    return not out.fail();
+}
+
+/**
+ * Begin a traced scope
+ */
+TraceBuffer* TraceScope::begin(const char* name, const AnyNode* node, size_t menus)
+{
+    TraceBuffer* buffer = Trace::buffer();
+    name_ = name;
+    depth_ = buffer->depth++;
+    menus_ = menus;
+
+    size_t length = 0;
+    if (node != NULL)
+    {
+        length = node->uri_.size();
+        if (length >= sizeof(uri_))
+            length = sizeof(uri_) - 1;
+        memcpy(uri_, node->uri_.data(), length);
+    }
+    uri_[length] = '\0';
+
+    start_ = Trace::ticks();
+    return buffer;
+}
+
+/**
+ * End a traced scope and write its event
+ */
+void TraceScope::end()
+{
+    uint64_t duration = Trace::ticks() - start_;
+    buffer_->depth--;
+
+    size_t head = buffer_->head;
+    TraceEvent& event = buffer_->events[head % buffer_->capacity];
+    event.name = name_;
+    event.start = start_;
+    event.duration = duration;
+    event.depth = depth_;
+    event.menus = menus_;
+    memcpy(event.uri, uri_, sizeof(uri_));
+
+    // Publish the event before counting it
+    __atomic_store_n(&buffer_->head, head + 1, __ATOMIC_RELEASE);
+}
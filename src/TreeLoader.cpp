@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TreeLoader.h"
+#include "Nodes/MenuNode.h"
+#include "Nodes/VirtualMenuNode.h"
+
+#include <fstream>
+
+using namespace naviengine;
+
+/**
+ * Constructor
+ */
+TreeLoader::TreeLoader() :
+        nodes_(0), line_(0), errorLine_(0)
+{
+}
+
+/**
+ * Load a model from a stream
+ *
+ * @param in The stream to read the description from
+ * @param rootName The name of the root, whose children are the nodes without indentation
+ * @return The root of the model, or NULL if the description is invalid
+ */
+MenuNode* TreeLoader::load(std::istream& in, const std::string& rootName)
+{
+    nodes_ = 0;
+    line_ = 0;
+    error_.clear();
+    errorLine_ = 0;
+
+    MenuNode* root = new MenuNode(rootName);
+    std::vector<Level> levels;
+    Level level;
+    level.indent = -1;
+    level.childIndent = -1;
+    level.node = root;
+    levels.push_back(level);
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        line_++;
+        if (not addLine(line, levels))
+        {
+            delete root;
+            return NULL;
+        }
+    }
+
+    if (in.bad())
+    {
+        fail("read error");
+        delete root;
+        return NULL;
+    }
+    return root;
+}
+
+/**
+ * Load a model from a file
+ *
+ * @param path The file to read the description from
+ * @param rootName The name of the root, whose children are the nodes without indentation
+ * @return The root of the model, or NULL if the file can not be read or is invalid
+ */
+MenuNode* TreeLoader::load(const std::string& path, const std::string& rootName)
+{
+    std::ifstream in(path.c_str());
+    if (not in)
+    {
+        nodes_ = 0;
+        line_ = 0;
+        fail("can not open " + path);
+        return NULL;
+    }
+    return load(in, rootName);
+}
+
+/**
+ * Get the number of nodes loaded by the last load, virtual children included
+ *
+ * @return The number of nodes
+ */
+size_t TreeLoader::nodes() const
+{
+    return nodes_;
+}
+
+/**
+ * Get the reason the last load failed
+ *
+ * @return The error message, empty if the load succeeded
+ */
+const std::string& TreeLoader::error() const
+{
+    return error_;
+}
+
+/**
+ * Get the line where the last load failed
+ *
+ * @return The line number starting from 1, or 0 if the load succeeded
+ */
+size_t TreeLoader::errorLine() const
+{
+    return errorLine_;
+}
+
+/**
+ * Add the node described by a line
+ *
+ * @param line The line to add
+ * @param levels The nodes on the path to the previous line, the root first
+ * @return true on success, otherwise false
+ */
+bool TreeLoader::addLine(const std::string& line, std::vector<Level>& levels)
+{
+    size_t end = line.size();
+    if (end > 0 && line[end - 1] == '\r')
+        end--;
+
+    size_t start = line.find_first_not_of(' ');
+    if (start >= end || line[start] == '#')
+        return true;
+
+    int indent = start;
+    while (levels.back().indent >= indent)
+        levels.pop_back();
+
+    Level& parent = levels.back();
+    if (parent.node == NULL)
+        return fail("virtual children can not have children");
+    if (parent.childIndent == -1)
+        parent.childIndent = indent;
+    else if (parent.childIndent != indent)
+        return fail("indentation does not match any previous line");
+
+    bool isVirtual = line[start] == '~';
+    if (isVirtual)
+        start++;
+
+    // The name, uri and info are separated by tabs
+    size_t nameEnd = line.find('\t', start);
+    if (nameEnd > end)
+        nameEnd = end;
+    size_t uriEnd = (nameEnd < end) ? line.find('\t', nameEnd + 1) : end;
+    if (uriEnd > end)
+        uriEnd = end;
+    if (nameEnd == start)
+        return fail("missing name");
+
+    Level level;
+    level.indent = indent;
+    level.childIndent = -1;
+    level.node = NULL;
+
+    if (parent.node->isVirtual())
+    {
+        if (isVirtual)
+            return fail("virtual children can not be virtual menus");
+
+        VirtualNode child(line.substr(start, nameEnd - start));
+        if (uriEnd > nameEnd + 1)
+            child.uri_.assign(line, nameEnd + 1, uriEnd - nameEnd - 1);
+        if (uriEnd < end)
+            child.info_.assign(line, uriEnd + 1, end - uriEnd - 1);
+        static_cast<VirtualMenuNode*>(parent.node)->addChild(child);
+    }
+    else
+    {
+        AnyNode* node;
+        if (isVirtual)
+            node = new VirtualMenuNode(line.substr(start, nameEnd - start));
+        else
+            node = new MenuNode(line.substr(start, nameEnd - start));
+        if (uriEnd > nameEnd + 1)
+            node->uri_.assign(line, nameEnd + 1, uriEnd - nameEnd - 1);
+        if (uriEnd < end)
+            node->info_.assign(line, uriEnd + 1, end - uriEnd - 1);
+        static_cast<MenuNode*>(parent.node)->addNode(node);
+        level.node = node;
+    }
+
+    nodes_++;
+    levels.push_back(level);
+    return true;
+}
+
+/**
+ * Record why the load failed
+ *
+ * @param message The reason
+ * @return false
+ */
+bool TreeLoader::fail(const std::string& message)
+{
+    error_ = message;
+    errorLine_ = line_;
+    return false;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAVIENGINE_TREELOADER
+#define NAVIENGINE_TREELOADER
+
+#include <stddef.h>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace naviengine
+{
+
+class AnyNode;
+class MenuNode;
+
+/**
+ * TreeLoader builds a model from a text description, one line at a time.
+ *
+ * Each line describes a node as
+ *
+ *     <indentation>[~]name[<tab>uri[<tab>info]]
+ *
+ * The indentation is made of spaces. A node's children follow it with a
+ * deeper indentation, and siblings must be indented alike. A name starting
+ * with ~ makes a VirtualMenuNode, whose children become its virtual
+ * children and can not have children of their own. Other nodes become
+ * MenuNodes. Nodes without a uri keep the one they generate. Empty lines
+ * and lines starting with # are skipped.
+ *
+ * Nodes are added to the model as soon as their line is read. Apart from
+ * the model, only the nodes on the path to the current line are kept.
+ */
+class TreeLoader
+{
+public:
+    TreeLoader();
+
+    MenuNode* load(std::istream& in, const std::string& rootName = "");
+    MenuNode* load(const std::string& path, const std::string& rootName = "");
+
+    size_t nodes() const;
+    const std::string& error() const;
+    size_t errorLine() const;
+
+private:
+    /** A node that may get children from the following lines */
+    struct Level
+    {
+        /** The indentation of the node's line */
+        int indent;
+        /** The indentation of the node's children, or -1 before the first child */
+        int childIndent;
+        /** The node, or NULL if it can not have children */
+        AnyNode* node;
+    };
+
+    bool addLine(const std::string& line, std::vector<Level>& levels);
+    bool fail(const std::string& message);
+
+    size_t nodes_;
+    size_t line_;
+    std::string error_;
+    size_t errorLine_;
+};
+}
+#endif
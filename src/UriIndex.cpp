@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "UriIndex.h"
+#include "Nodes/AnyNode.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace naviengine;
+
+namespace
+{
+/** Identifies an index file and its format version */
+const char MAGIC[8] = { 'N', 'A', 'V', 'I', 'U', 'R', 'I', '1' };
+
+/** The layout of the start of the file, followed by the records */
+struct Header
+{
+    char magic[8];
+    uint32_t count;
+    uint32_t reserved;
+};
+
+/** Orders entries by the byte values of their uris, as lookup does */
+bool byUri(const UriIndex::Entry& a, const UriIndex::Entry& b)
+{
+    size_t length = std::min(a.first.size(), b.first.size());
+    int result = memcmp(a.first.data(), b.first.data(), length);
+    if (result != 0)
+        return result < 0;
+    return a.first.size() < b.first.size();
+}
+
+/** Tells if two entries have the same uri */
+bool sameUri(const UriIndex::Entry& a, const UriIndex::Entry& b)
+{
+    return a.first == b.first;
+}
+
+/** Add the uri of each node below a node, depth first */
+void collectChildren(AnyNode* node, std::vector<int>& locator, std::vector<UriIndex::Entry>& entries)
+{
+    AnyNode* first = node->firstChild();
+    AnyNode* child = first;
+    for (int i = 0; child != NULL; ++i)
+    {
+        locator.push_back(i);
+        entries.push_back(UriIndex::Entry(child->uri_, locator));
+        collectChildren(child, locator, entries);
+        locator.pop_back();
+
+        child = child->next_;
+        if (child == first)
+            child = NULL;
+    }
+}
+}
+
+/**
+ * Constructor
+ *
+ * Creates a closed index.
+ */
+UriIndex::UriIndex() :
+        data_(NULL), length_(0), count_(0), records_(NULL)
+{
+}
+
+/**
+ * Destructor
+ */
+UriIndex::~UriIndex()
+{
+    close();
+}
+
+/**
+ * Write an index file
+ *
+ * @param path The file to write
+ * @param entries The uris and locators to write, sorted by this call. If a
+ * uri is given more than once, only its first entry is kept.
+ * @return true on success, otherwise false
+ */
+bool UriIndex::write(const std::string& path, std::vector<Entry>& entries)
+{
+    std::stable_sort(entries.begin(), entries.end(), byUri);
+    entries.erase(std::unique(entries.begin(), entries.end(), sameUri), entries.end());
+
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.count = entries.size();
+    header.reserved = 0;
+
+    // The keys and locators follow the records, locators are kept aligned
+    std::vector<Record> records(entries.size());
+    uint64_t offset = sizeof(Header) + records.size() * sizeof(Record);
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        records[i].locatorOffset = offset;
+        records[i].locatorLength = entries[i].second.size();
+        offset += entries[i].second.size() * sizeof(int32_t);
+    }
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        records[i].keyOffset = offset;
+        records[i].keyLength = entries[i].first.size();
+        offset += entries[i].first.size();
+    }
+    if (offset > 0xffffffffu)
+        return false;
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL)
+        return false;
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (success && not records.empty())
+        success = fwrite(&records[0], sizeof(Record), records.size(), file) == records.size();
+    for (size_t i = 0; success && i < entries.size(); ++i)
+    {
+        const std::vector<int>& locator = entries[i].second;
+        for (size_t j = 0; success && j < locator.size(); ++j)
+        {
+            int32_t index = locator[j];
+            success = fwrite(&index, sizeof(index), 1, file) == 1;
+        }
+    }
+    for (size_t i = 0; success && i < entries.size(); ++i)
+    {
+        success = fwrite(entries[i].first.data(), 1, entries[i].first.size(), file) == entries[i].first.size();
+    }
+
+    if (fclose(file) != 0)
+        success = false;
+    return success;
+}
+
+/**
+ * Collect the uris and locators of all nodes below a root
+ *
+ * Only children that exist are collected, nodes that build their children
+ * in onOpen must have been opened.
+ *
+ * @param root The root of the model
+ * @param entries The vector to add the entries to
+ */
+void UriIndex::collect(AnyNode* root, std::vector<Entry>& entries)
+{
+    std::vector<int> locator;
+    collectChildren(root, locator, entries);
+}
+
+/**
+ * Open an index file
+ *
+ * @param path The file written by write
+ * @return true on success, otherwise false
+ */
+bool UriIndex::open(const std::string& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(Header))
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    const Header* header = static_cast<const Header*>(data);
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0
+            || header->count > (info.st_size - sizeof(Header)) / sizeof(Record))
+    {
+        munmap(data, info.st_size);
+        return false;
+    }
+
+    // Lookups jump around the file, read ahead would only waste memory
+    madvise(data, info.st_size, MADV_RANDOM);
+
+    data_ = static_cast<const char*>(data);
+    length_ = info.st_size;
+    count_ = header->count;
+    records_ = reinterpret_cast<const Record*>(data_ + sizeof(Header));
+    return true;
+}
+
+/**
+ * Close the index file
+ */
+void UriIndex::close()
+{
+    if (data_ != NULL)
+        munmap(const_cast<char*>(data_), length_);
+    data_ = NULL;
+    length_ = 0;
+    count_ = 0;
+    records_ = NULL;
+}
+
+/**
+ * Check if an index file is open
+ *
+ * @return true if open, otherwise false
+ */
+bool UriIndex::isOpen() const
+{
+    return data_ != NULL;
+}
+
+/**
+ * Get the number of uris in the index
+ *
+ * @return The number of uris
+ */
+size_t UriIndex::size() const
+{
+    return count_;
+}
+
+/**
+ * Find the locator of a uri
+ *
+ * The records are binary searched, so a lookup reads the pages of about
+ * log2(size) records and keys.
+ *
+ * @param uri The uri to look for
+ * @param locator Set to the child indices leading from the root to the node
+ * @return true if the uri was found, otherwise false
+ */
+bool UriIndex::lookup(const std::string& uri, std::vector<int>& locator) const
+{
+    uint32_t low = 0;
+    uint32_t high = count_;
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        const Record& record = records_[middle];
+        if (record.keyOffset > length_ || record.keyLength > length_ - record.keyOffset)
+            return false;
+
+        size_t length = std::min<size_t>(record.keyLength, uri.size());
+        int result = memcmp(data_ + record.keyOffset, uri.data(), length);
+        if (result == 0 && record.keyLength != uri.size())
+            result = (record.keyLength < uri.size()) ? -1 : 1;
+
+        if (result < 0)
+        {
+            low = middle + 1;
+        }
+        else if (result > 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            if (record.locatorOffset > length_
+                    || record.locatorLength > (length_ - record.locatorOffset) / sizeof(int32_t))
+                return false;
+
+            const int32_t* indices = reinterpret_cast<const int32_t*>(data_ + record.locatorOffset);
+            locator.assign(indices, indices + record.locatorLength);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAVIENGINE_URIINDEX
+#define NAVIENGINE_URIINDEX
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace naviengine
+{
+
+class AnyNode;
+
+/**
+ * A persistent index from uris to the nodes they address.
+ *
+ * The index is a file of uris sorted by byte value, each with a locator: the
+ * child indices leading from the model root to the node. The file is memory
+ * mapped when opened, so only the pages touched by the binary search of a
+ * lookup are read and the uris are never held as strings in memory.
+ *
+ * Indices are given to NaviEngine::setUriIndex to let selectNodeByUri find
+ * nodes that are not children of the current node.
+ */
+class UriIndex
+{
+public:
+    /** A uri and the child indices leading to its node */
+    typedef std::pair<std::string, std::vector<int> > Entry;
+
+    UriIndex();
+    ~UriIndex();
+
+    static bool write(const std::string& path, std::vector<Entry>& entries);
+    static void collect(AnyNode* root, std::vector<Entry>& entries);
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+    size_t size() const;
+
+    bool lookup(const std::string& uri, std::vector<int>& locator) const;
+
+private:
+    UriIndex(const UriIndex&);
+    UriIndex& operator=(const UriIndex&);
+
+    /** The layout of an entry in the file */
+    struct Record
+    {
+        uint32_t keyOffset;
+        uint32_t keyLength;
+        uint32_t locatorOffset;
+        uint32_t locatorLength;
+    };
+
+    const char* data_;
+    size_t length_;
+    uint32_t count_;
+    const Record* records_;
+};
+}
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAVIENGINE_TESTNAVI
+#define NAVIENGINE_TESTNAVI
+
+#include "NaviEngine.h"
+
+#include <time.h>
+#include <string>
+
+/**
+ * Engine for the tests: no context menu and silent narration. Tests derive
+ * from it to override only the hooks they observe.
+ */
+class TestNavi: public naviengine::NaviEngine
+{
+public:
+    naviengine::MenuNode* buildContextMenu()
+    {
+        return 0;
+    }
+private:
+    void narrateChange(const MenuState& /* before */, const MenuState& /* after */)
+    {
+    }
+    void narrate(const std::string /* text */)
+    {
+    }
+    void narrate(const int /* value */)
+    {
+    }
+    void narrateStop()
+    {
+    }
+    void narrateShortPause()
+    {
+    }
+    void narrateLongPause()
+    {
+    }
+};
+
+/**
+ * Monotonic time in seconds, for tests that report how long something took.
+ */
+inline double seconds()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+#endif
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <vector>
+
+using namespace naviengine;
+
+std::vector<std::string> narrated;
+int changes = 0;
+volatile int completed = 0;
+int aborts = 0;
+
+class Navi: public TestNavi
+{
+private:
+    void narrateChange(const MenuState& before, const MenuState& after)
+    {
+        changes++;
+    }
+    void narrate(const std::string text)
+    {
+        narrated.push_back(text);
+    }
+    void openCompleted()
+    {
+        __sync_add_and_fetch(&completed, 1);
+    }
+};
+
+// A node that loads its children on another thread
+class LoadingNode: public MenuNode
+{
+public:
+    LoadingNode(const std::string& name) :
+            MenuNode(name), ticket(0), aborted(0), started(0), navi_(0)
+    {
+    }
+
+    bool onOpen(NaviEngine& navi)
+    {
+        if (firstChild() != NULL)
+            return true;
+        navi_ = &navi;
+        ticket = navi.deferOpen(this);
+        started++;
+        pthread_create(&thread_, NULL, LoadingNode::load, this);
+        return true;
+    }
+
+    bool onOpenComplete(NaviEngine& navi)
+    {
+        addNode(new MenuNode("loaded 1"));
+        addNode(new MenuNode("loaded 2"));
+        return true;
+    }
+
+    bool abort()
+    {
+        aborted++;
+        aborts++;
+        return true;
+    }
+
+    void join()
+    {
+        pthread_join(thread_, NULL);
+    }
+
+    unsigned long ticket;
+    int aborted;
+    int started;
+
+private:
+    static void* load(void* node)
+    {
+        LoadingNode* self = static_cast<LoadingNode*>(node);
+        self->navi_->completeOpen(self->ticket);
+        return NULL;
+    }
+
+    NaviEngine* navi_;
+    pthread_t thread_;
+};
+
+// wait until the loading thread has completed an open
+void wait_completed(int count)
+{
+    while (__sync_add_and_fetch(&completed, 0) < count)
+        sched_yield();
+}
+
+int main()
+{
+    MenuNode* root = new MenuNode("root");
+    LoadingNode* first = new LoadingNode("first");
+    LoadingNode* second = new LoadingNode("second");
+    root->addNode(first);
+    root->addNode(second);
+
+    Navi navi;
+    assert(navi.openMenu(root));
+    assert(not navi.openPending());
+
+    // opening a loading node narrates the loading state
+    narrated.clear();
+    changes = 0;
+    assert(navi.select());
+    assert(navi.getCurrentNode() == first);
+    assert(navi.getCurrentChoice() == NULL);
+    assert(navi.openPending());
+    assert(first->ticket != 0);
+    assert(changes == 1);
+    assert(narrated.size() == 1 && narrated[0] == "loading");
+
+    // the completion is delivered on the engine thread
+    wait_completed(1);
+    first->join();
+    assert(first->firstChild() == NULL);
+    assert(navi.deliverCompletions());
+    assert(not navi.openPending());
+    assert(first->numberOfChildren() == 2);
+    assert(navi.getCurrentChoice() == first->firstChild());
+    assert(changes == 2);
+    assert(not navi.deliverCompletions());
+
+    // an opened node is not loaded again
+    assert(navi.up());
+    assert(navi.select());
+    assert(not navi.openPending());
+    assert(first->started == 1);
+    assert(first->aborted == 0);
+
+    // navigating away aborts the open and drops its completion
+    assert(navi.up());
+    assert(navi.next());
+    assert(navi.select());
+    assert(navi.getCurrentNode() == second);
+    assert(navi.openPending());
+    unsigned long aborted = second->ticket;
+    assert(navi.up());
+    assert(second->aborted == 1);
+    assert(not navi.openPending());
+    wait_completed(2);
+    second->join();
+    assert(not navi.deliverCompletions());
+    assert(second->firstChild() == NULL);
+
+    // moving within the loading node does not abort it
+    assert(navi.select());
+    assert(navi.openPending());
+    assert(second->ticket != aborted);
+    assert(not navi.next());
+    assert(second->aborted == 1);
+    wait_completed(3);
+    second->join();
+    assert(navi.deliverCompletions());
+    assert(second->numberOfChildren() == 2);
+
+    // a pending open is cancelled when its node is deleted
+    MenuNode* shelf = new MenuNode("shelf");
+    LoadingNode* deleted = new LoadingNode("deleted");
+    shelf->addNode(deleted);
+    root->addNode(shelf);
+    assert(navi.up());
+    assert(navi.next());
+    assert(navi.getCurrentChoice() == shelf);
+    assert(navi.select());
+    assert(navi.select());
+    assert(navi.getCurrentNode() == deleted);
+    assert(navi.openPending());
+    wait_completed(4);
+    deleted->join();
+    navi.setCurrentNode(root);
+    navi.setCurrentChoice(root->firstChild());
+    shelf->clearNodes();
+    assert(not navi.openPending());
+    assert(navi.next());
+    assert(not navi.deliverCompletions());
+
+    // a pending open is aborted when the engine is destroyed
+    Navi* other = new Navi();
+    MenuNode* model = new MenuNode("model");
+    LoadingNode* node = new LoadingNode("node");
+    model->addNode(node);
+    assert(other->openMenu(model));
+    assert(other->select());
+    assert(other->openPending());
+    wait_completed(5);
+    node->join();
+    int before = aborts;
+    delete other;
+    assert(aborts == before + 1);
+
+    return 0;
+}
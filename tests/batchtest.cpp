@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <string>
+
+using namespace naviengine;
+
+int onOpenCalls = 0;
+int narrateChanges = 0;
+int narrations = 0;
+NaviEngine::MenuState lastBefore;
+NaviEngine::MenuState lastAfter;
+std::string lastBeforeName;
+int deletedMenus = 0;
+
+class CountingNode: public MenuNode
+{
+public:
+    CountingNode(std::string name)
+        : MenuNode(name)
+    {
+    }
+
+    bool onOpen(NaviEngine& navi)
+    {
+        onOpenCalls++;
+        return true;
+    }
+};
+
+class ContextMenuNode: public MenuNode
+{
+public:
+    ContextMenuNode(std::string name)
+        : MenuNode(name)
+    {
+    }
+
+    ~ContextMenuNode()
+    {
+        deletedMenus++;
+    }
+};
+
+class Navi: public TestNavi
+{
+private:
+    void narrateChange(const MenuState& before, const MenuState& after)
+    {
+        narrateChanges++;
+        if (before.state.currentNode != NULL)
+            lastBeforeName = before.state.currentNode->name_;
+        lastBefore = before;
+        lastAfter = after;
+    }
+    void narrate(const std::string text)
+    {
+        narrations++;
+    }
+    void narrate(const int value)
+    {
+        narrations++;
+    }
+    void narrateStop()
+    {
+        narrations++;
+    }
+    void narrateShortPause()
+    {
+        narrations++;
+    }
+    void narrateLongPause()
+    {
+        narrations++;
+    }
+};
+
+MenuNode* menu_model_builder()
+{
+    MenuNode* root = new CountingNode("root");
+
+    MenuNode* l1c1 = new CountingNode("level 1, child 1");
+    root->addNode(l1c1);
+    MenuNode* l1c2 = new CountingNode("level 1, child 2");
+    root->addNode(l1c2);
+
+    l1c1->addNode(new CountingNode("level 2, child 1"));
+    l1c2->addNode(new CountingNode("level 2, child 2"));
+    l1c2->addNode(new CountingNode("level 2, child 3"));
+
+    return root;
+}
+
+void reset()
+{
+    onOpenCalls = 0;
+    narrateChanges = 0;
+    narrations = 0;
+}
+
+int main()
+{
+    Navi navi;
+
+    // commit without a batch should fail
+    assert(not navi.commit());
+    assert(not navi.inBatch());
+
+    naviengine::MenuNode* model = menu_model_builder();
+    assert(navi.openMenu(model));
+    AnyNode* root = navi.getCurrentNode();
+
+    // a batch of commands narrates and opens only once on commit
+    reset();
+    navi.beginBatch();
+    assert(navi.inBatch());
+    assert(navi.next());
+    assert(navi.select());
+    assert(navi.next());
+    assert(navi.select());
+    assert(navi.getCurrentNode()->name_ == "level 2, child 3");
+    navi.narrateNode();
+    assert(not navi.renderNode(navi.getCurrentNode()));
+    assert(onOpenCalls == 0);
+    assert(narrateChanges == 0);
+    assert(narrations == 0);
+
+    assert(navi.commit());
+    assert(not navi.inBatch());
+    assert(onOpenCalls == 1);
+    assert(narrateChanges == 1);
+    assert(lastBefore.state.currentNode == root);
+    assert(lastAfter.state.currentNode->name_ == "level 2, child 3");
+
+    // nested batches take effect on the outermost commit
+    reset();
+    navi.beginBatch();
+    assert(navi.up());
+    navi.beginBatch();
+    assert(navi.up());
+    assert(navi.commit());
+    assert(navi.inBatch());
+    assert(narrateChanges == 0);
+    assert(navi.commit());
+    assert(navi.getCurrentNode() == root);
+    assert(onOpenCalls == 1);
+    assert(narrateChanges == 1);
+
+    // a batch that only moves the choice narrates without opening
+    reset();
+    navi.beginBatch();
+    assert(navi.next());
+    assert(navi.next());
+    assert(navi.next());
+    assert(navi.commit());
+    assert(onOpenCalls == 0);
+    assert(narrateChanges == 1);
+
+    // an empty batch narrates nothing
+    reset();
+    navi.beginBatch();
+    assert(navi.commit());
+    assert(narrateChanges == 0);
+
+    // a menu closed during a batch is deleted after the change is narrated
+    ContextMenuNode* menu = new ContextMenuNode("menu");
+    menu->addNode(new CountingNode("item"));
+    assert(navi.openMenu(menu));
+    reset();
+    navi.beginBatch();
+    assert(navi.closeMenu());
+    assert(deletedMenus == 0);
+    assert(navi.commit());
+    assert(narrateChanges == 1);
+    assert(lastBeforeName == "menu");
+    assert(deletedMenus == 1);
+
+    // also when top closes it
+    menu = new ContextMenuNode("menu");
+    menu->addNode(new CountingNode("item"));
+    assert(navi.openMenu(menu));
+    reset();
+    navi.beginBatch();
+    assert(navi.top());
+    assert(deletedMenus == 1);
+    assert(navi.commit());
+    assert(lastBeforeName == "menu");
+    assert(deletedMenus == 2);
+
+    // and when the engine is deleted before the batch is committed
+    {
+        Navi other;
+        assert(other.openMenu(menu_model_builder()));
+        assert(other.openMenu(new ContextMenuNode("menu")));
+        other.beginBatch();
+        assert(other.closeMenu());
+    }
+    assert(deletedMenus == 3);
+
+    return 0;
+}
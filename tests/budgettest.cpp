@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "Nodes/VirtualMenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace naviengine;
+
+int populations = 0;
+size_t narrated = 0;
+
+// a node that builds its children when opened and can release them again
+class AuthorNode: public MenuNode
+{
+public:
+    AuthorNode(std::string name)
+        : MenuNode(name)
+    {
+        setEvictable(true);
+    }
+
+    bool onOpen(NaviEngine& navi)
+    {
+        if (firstChild() == NULL)
+        {
+            populations++;
+            for (int i = 0; i < 100; i++)
+            {
+                std::ostringstream name;
+                name << name_ << ", book " << i;
+                addNode(new MenuNode(name.str()));
+            }
+        }
+        if (navi.getCurrentNode() == this && navi.getCurrentChoice() == NULL)
+            navi.setCurrentChoice(firstChild());
+        return true;
+    }
+};
+
+// a virtual node that builds its children when opened
+class TitlesNode: public VirtualMenuNode
+{
+public:
+    TitlesNode(std::string name)
+        : VirtualMenuNode(name)
+    {
+        setEvictable(true);
+    }
+
+    bool onOpen(NaviEngine& navi)
+    {
+        if (children.empty())
+        {
+            populations++;
+            for (int i = 0; i < 100; i++)
+                addChild(VirtualNode("title"));
+        }
+        return true;
+    }
+};
+
+class Navi: public TestNavi
+{
+private:
+    // reads the nodes, so narrating an evicted node fails under ASan
+    void narrateChange(const MenuState& before, const MenuState& after)
+    {
+        if (before.state.currentNode != NULL)
+            narrated += before.state.currentNode->name_.size();
+        narrated += after.state.currentNode->name_.size();
+    }
+    void renderChange(const RenderDelta& delta)
+    {
+        if (delta.before.currentNode != NULL)
+            narrated += delta.before.currentNode->name_.size();
+    }
+};
+
+int main()
+{
+    MenuNode* root = new MenuNode("catalog");
+    AuthorNode* authors[50];
+    for (int i = 0; i < 50; i++)
+    {
+        std::ostringstream name;
+        name << "author " << i;
+        authors[i] = new AuthorNode(name.str());
+        root->addNode(authors[i]);
+    }
+
+    Navi navi;
+    assert(navi.memoryInUse() == 0);
+    navi.setMemoryBudget(64 * 1024);
+    assert(navi.openMenu(root));
+
+    // browse every author, the budget keeps the opened subtrees bounded
+    for (int i = 0; i < 50; i++)
+    {
+        assert(navi.select());
+        assert(navi.getCurrentNode() == authors[i]);
+        assert(navi.numberOfChildren(authors[i]) == 100);
+        assert(navi.next());
+        assert(navi.up());
+        assert(navi.memoryInUse() <= 64 * 1024);
+        assert(navi.next());
+    }
+    assert(populations == 50);
+
+    // old subtrees have been evicted, the most recent ones are kept
+    assert(authors[0]->firstChild() == NULL);
+    assert(authors[49]->firstChild() != NULL);
+
+    // an evicted subtree is built again when opened
+    assert(navi.getCurrentChoice() == authors[0]);
+    assert(navi.select());
+    assert(navi.numberOfChildren(authors[0]) == 100);
+    assert(populations == 51);
+
+    // the path to the current node is never evicted, even with a tiny budget
+    assert(navi.select());
+    navi.setMemoryBudget(1);
+    assert(navi.getCurrentNode()->parent_ == authors[0]);
+    assert(navi.numberOfChildren(authors[0]) == 100);
+    assert(navi.up());
+    assert(navi.up());
+    assert(authors[49]->firstChild() == NULL);
+
+    // the nodes a command is narrated and rendered with are evicted after it
+    assert(navi.select());
+    assert(navi.select());
+    navi.setMemoryBudget(1);
+    assert(navi.top());
+    assert(authors[0]->firstChild() == NULL);
+
+    // the same holds for a batch, it is narrated and evicted on commit
+    assert(navi.select());
+    assert(navi.select());
+    navi.beginBatch();
+    assert(navi.top());
+    std::vector<int> indices;
+    indices.push_back(1);
+    indices.push_back(0);
+    assert(navi.selectPath(indices));
+    assert(authors[0]->firstChild() != NULL);
+    assert(navi.commit());
+    assert(authors[0]->firstChild() == NULL);
+    assert(navi.top());
+
+    // removing the budget stops tracking
+    navi.setMemoryBudget(0);
+    assert(navi.memoryInUse() == 0);
+
+    // built-in nodes keep their children unless they are made evictable
+    MenuNode* shelf = new MenuNode("shelf");
+    MenuNode* fixed = new MenuNode("fixed");
+    for (int i = 0; i < 100; i++)
+        fixed->addNode(new MenuNode("item"));
+    shelf->addNode(fixed);
+    TitlesNode* titles[20];
+    for (int i = 0; i < 20; i++)
+    {
+        titles[i] = new TitlesNode("titles");
+        shelf->addNode(titles[i]);
+    }
+
+    Navi other;
+    other.setMemoryBudget(128 * 1024);
+    assert(other.openMenu(shelf));
+    populations = 0;
+    for (int i = 0; i < 21; i++)
+    {
+        assert(other.select());
+        assert(other.up());
+        assert(other.next());
+    }
+    assert(populations == 20);
+    assert(fixed->numberOfChildren() == 100);
+    assert(titles[0]->children.empty());
+    assert(not titles[19]->children.empty());
+
+    return 0;
+}
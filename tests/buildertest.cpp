@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ModelBuilder.h"
+#include "Nodes/MenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace naviengine;
+
+// build a shelf of books, each with a few chapters
+class ShelfBuilder: public SubtreeBuilder
+{
+public:
+    ShelfBuilder(int shelf, int books) :
+            shelf_(shelf), books_(books)
+    {
+    }
+
+    AnyNode* build()
+    {
+        if (books_ < 0)
+            return NULL;
+
+        std::ostringstream name;
+        name << "shelf " << shelf_;
+        MenuNode* shelf = new MenuNode(name.str());
+        for (int i = 0; i < books_; i++)
+        {
+            std::ostringstream book;
+            book << "book " << shelf_ << "." << i;
+            MenuNode* bookNode = new MenuNode(book.str());
+            bookNode->uri_ = "urn:" + book.str();
+            for (int j = 0; j < 3; j++)
+                bookNode->addNode(new MenuNode("chapter"));
+            shelf->addNode(bookNode);
+        }
+        return shelf;
+    }
+
+private:
+    int shelf_;
+    int books_;
+};
+
+// check the links of the children of a node and return their number
+int check_children(MenuNode* node)
+{
+    AnyNode* first = node->firstChild();
+    int count = 0;
+    for (AnyNode* child = first; child != NULL; count++)
+    {
+        assert(child->parent_ == node);
+        assert(child->next_->prev_ == child);
+        assert(node->childAt(count) == child);
+        assert(node->indexOf(child) == count);
+        child = child->next_;
+        if (child == first)
+            child = NULL;
+    }
+    assert(count == node->numberOfChildren());
+    return count;
+}
+
+double build(unsigned int threads, int shelves, int books, MenuNode* root)
+{
+    double start = seconds();
+    ModelBuilder builder(threads);
+    for (int i = 0; i < shelves; i++)
+        builder.add(new ShelfBuilder(i, books));
+    assert(builder.splice(root));
+    return seconds() - start;
+}
+
+int main(int argc, char** argv)
+{
+    int shelves = (argc > 1) ? atoi(argv[1]) : 64;
+    int books = (argc > 2) ? atoi(argv[2]) : 2000;
+
+    // the subtrees are spliced after the existing children, in order
+    MenuNode* root = new MenuNode("root");
+    root->addNode(new MenuNode("settings"));
+    double single = build(1, shelves, books, root);
+    assert(check_children(root) == shelves + 1);
+    for (int i = 0; i < shelves; i++)
+    {
+        std::ostringstream name;
+        name << "shelf " << i;
+        MenuNode* shelf = dynamic_cast<MenuNode*>(root->childAt(i + 1));
+        assert(shelf->name_ == name.str());
+        assert(check_children(shelf) == books);
+    }
+
+    MenuNode* parallelRoot = new MenuNode("root");
+    ModelBuilder probe;
+    double parallel = build(probe.threads(), shelves, books, parallelRoot);
+    assert(check_children(parallelRoot) == shelves);
+    for (int i = 0; i < shelves; i++)
+        assert(parallelRoot->childAt(i)->name_ == root->childAt(i + 1)->name_);
+
+    // the scaling is reported, not checked, as it depends on the machine
+    std::cout << shelves * books * 4 << " nodes: " << single << " s on 1 thread, " << parallel << " s on "
+            << probe.threads() << " threads, " << single / parallel << " times as fast" << std::endl;
+
+    // a failed subtree is reported, the others are spliced
+    MenuNode* partial = new MenuNode("partial");
+    ModelBuilder builder(2);
+    builder.add(new ShelfBuilder(0, 10));
+    builder.add(new ShelfBuilder(1, -1));
+    builder.add(new ShelfBuilder(2, 10));
+    assert(not builder.splice(partial));
+    assert(check_children(partial) == 2);
+    assert(partial->childAt(1)->name_ == "shelf 2");
+
+    // the builder can be reused, unspliced subtrees are deleted with it
+    builder.add(new ShelfBuilder(3, 10));
+    assert(builder.splice(partial));
+    assert(check_children(partial) == 3);
+    builder.add(new ShelfBuilder(4, 10));
+
+    // splicing nothing leaves the parent alone
+    ModelBuilder empty(1);
+    assert(empty.splice(partial));
+    assert(check_children(partial) == 3);
+
+    delete partial;
+    delete parallelRoot;
+    delete root;
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Nodes/MenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <iostream>
+
+using namespace naviengine;
+
+// check the links and positions of the children of a node
+void check_children(MenuNode* node, int count)
+{
+    assert(node->numberOfChildren() == count);
+    AnyNode* child = node->firstChild();
+    for (int i = 0; i < count; i++)
+    {
+        assert(node->childAt(i) == child);
+        assert(node->indexOf(child) == i);
+        assert(child->parent_ == node);
+        assert(child->next_->prev_ == child);
+        child = child->next_;
+    }
+    assert(count == 0 || child == node->firstChild());
+}
+
+int main()
+{
+    // small menus keep their children inside the node
+    MenuNode small("small");
+    size_t empty = small.memoryUsage();
+    for (int i = 0; i < ChildList::INLINE_CAPACITY; i++)
+    {
+        small.addNode(new MenuNode("child"));
+        check_children(&small, i + 1);
+    }
+    assert(small.memoryUsage() == empty);
+
+    // larger menus spill to the heap and keep their order
+    small.addNode(new MenuNode("spilled"));
+    check_children(&small, ChildList::INLINE_CAPACITY + 1);
+    assert(small.lastChild()->name_ == "spilled");
+    assert(small.memoryUsage() > empty);
+
+    // clearing releases the heap storage
+    small.clearNodes();
+    check_children(&small, 0);
+    assert(small.memoryUsage() == empty);
+    small.addNode(new MenuNode("again"));
+    check_children(&small, 1);
+
+    std::vector<AnyNode*> nodes;
+    for (int i = 0; i < 20; i++)
+        nodes.push_back(new MenuNode("added"));
+    small.addNodes(nodes);
+    check_children(&small, 21);
+
+    // building many small menus
+    const int menus = 100000;
+    double start = seconds();
+    MenuNode* root = new MenuNode("root");
+    for (int i = 0; i < menus; i++)
+    {
+        MenuNode* menu = new MenuNode("menu");
+        for (int j = 0; j < 5; j++)
+            menu->addNode(new MenuNode("item"));
+        root->addNode(menu);
+    }
+    double built = seconds() - start;
+    delete root;
+    std::cout << menus << " menus of 5 items built in " << built << " s" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace naviengine;
+
+int changes = 0;
+int opened = 0;
+
+class Navi: public TestNavi
+{
+public:
+    MenuNode* buildContextMenu()
+    {
+        MenuNode* menu = new MenuNode("context");
+        menu->addNode(new MenuNode("help"));
+        return menu;
+    }
+private:
+    void narrateChange(const MenuState& before, const MenuState& after)
+    {
+        changes++;
+    }
+};
+
+// a node counting how often it is opened
+class CountingNode: public MenuNode
+{
+public:
+    CountingNode(const std::string& name) :
+            MenuNode(name)
+    {
+        uri_ = name;
+    }
+
+    bool onOpen(NaviEngine&)
+    {
+        opened++;
+        return true;
+    }
+};
+
+// build shelves a .. d with books 0 .. 9, each book with two chapters
+MenuNode* build_library()
+{
+    MenuNode* root = new CountingNode("library");
+    for (char shelf = 'a'; shelf <= 'd'; shelf++)
+    {
+        MenuNode* shelfNode = new CountingNode(std::string("shelf ") + shelf);
+        for (int i = 0; i < 10; i++)
+        {
+            std::ostringstream name;
+            name << shelf << i;
+            MenuNode* book = new CountingNode(name.str());
+            book->addNode(new CountingNode(name.str() + " chapter 1"));
+            book->addNode(new CountingNode(name.str() + " chapter 2"));
+            shelfNode->addNode(book);
+        }
+        root->addNode(shelfNode);
+    }
+    return root;
+}
+
+std::vector<std::string> path(const std::string& shelf, const std::string& book)
+{
+    std::vector<std::string> uris;
+    uris.push_back(shelf);
+    if (not book.empty())
+        uris.push_back(book);
+    return uris;
+}
+
+int main()
+{
+    MenuNode* library = build_library();
+    Navi navi;
+    navi.setHistorySize(4);
+    assert(navi.openMenu(library));
+    assert(not navi.back());
+    assert(not navi.forward());
+
+    // jump around and come back without replaying the path
+    assert(navi.selectPath(path("shelf a", "a3")));
+    assert(navi.next());
+    assert(navi.getCurrentChoice()->name_ == "a3 chapter 2");
+    assert(navi.top());
+    assert(navi.selectPath(path("shelf c", "c7")));
+    assert(navi.getCurrentNode()->name_ == "c7");
+
+    changes = 0;
+    opened = 0;
+    assert(navi.back());
+    assert(navi.getCurrentNode()->name_ == "library");
+    assert(navi.getCurrentChoice()->name_ == "shelf a");
+    assert(navi.back());
+    assert(navi.getCurrentNode()->name_ == "a3");
+    assert(navi.getCurrentChoice()->name_ == "a3 chapter 2");
+    assert(changes == 2);
+    assert(opened == 2);
+
+    // up works from a restored node
+    assert(navi.up());
+    assert(navi.getCurrentNode()->name_ == "shelf a");
+    assert(navi.getCurrentChoice()->name_ == "a3");
+
+    // going back to a3 and forward again
+    assert(navi.back());
+    assert(navi.getCurrentNode()->name_ == "a3");
+    assert(navi.forward());
+    assert(navi.getCurrentNode()->name_ == "shelf a");
+    assert(not navi.forward());
+
+    // a new visit drops the forward entries
+    assert(navi.back());
+    assert(navi.up());
+    assert(navi.up());
+    assert(not navi.forward());
+
+    // the history is bounded, the oldest entries are dropped
+    for (char shelf = 'a'; shelf <= 'd'; shelf++)
+    {
+        assert(navi.top());
+        assert(navi.selectPath(path(std::string("shelf ") + shelf, "")));
+    }
+    int steps = 0;
+    while (navi.back())
+        steps++;
+    assert(steps == 3);
+    assert(navi.getCurrentNode()->name_ == "library");
+    assert(navi.forward());
+    assert(navi.getCurrentNode()->name_ == "shelf c");
+    while (navi.forward())
+        ;
+    assert(navi.getCurrentNode()->name_ == "shelf d");
+
+    // entries of deleted nodes are dropped, the library is left three times
+    navi.setHistorySize(10);
+    assert(navi.top());
+    assert(navi.selectPath(path("shelf b", "b1")));
+    assert(navi.top());
+    assert(navi.selectPath(path("shelf b", "b2")));
+    assert(navi.top());
+    assert(navi.selectPath(path("shelf a", "")));
+    MenuNode* shelfB = dynamic_cast<MenuNode*>(library->childAt(1));
+    shelfB->clearNodes();
+    for (int i = 0; i < 10; i++)
+        shelfB->addNode(new CountingNode("new book"));
+    assert(navi.back());
+    assert(navi.getCurrentNode()->name_ == "library");
+    assert(navi.back());
+    assert(navi.getCurrentNode()->name_ == "library");
+    assert(navi.back());
+    assert(navi.getCurrentNode()->name_ == "library");
+    steps = 0;
+    while (navi.forward())
+        steps++;
+    assert(steps == 3);
+    assert(navi.getCurrentNode()->name_ == "shelf a");
+
+    // entries of a closed menu are dropped
+    assert(navi.openMenu(navi.buildContextMenu()));
+    assert(navi.select());
+    assert(navi.getCurrentNode()->name_ == "help");
+    assert(navi.closeMenu());
+    assert(navi.getCurrentNode()->name_ == "shelf a");
+    assert(navi.back());
+    assert(navi.getCurrentNode()->name_ == "library");
+
+    // no history when disabled
+    navi.setHistorySize(0);
+    assert(navi.select());
+    assert(not navi.back());
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "Nodes/VirtualMenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace naviengine;
+
+int moved = 0;
+
+class Navi: public TestNavi
+{
+private:
+    void narrateChange(const MenuState& before, const MenuState& after)
+    {
+        if (choiceId(before) != choiceId(after))
+            moved++;
+    }
+};
+
+int main()
+{
+    MenuNode* root = new MenuNode("root");
+    MenuNode* a = new MenuNode("a");
+    MenuNode* b = new MenuNode("b");
+    VirtualMenuNode* pages = new VirtualMenuNode("pages");
+    root->addNode(a);
+    root->addNode(b);
+    root->addNode(pages);
+    b->addNode(new MenuNode("b1"));
+
+    // ids are unique, also between nodes and virtual nodes
+    std::set<uint64_t> ids;
+    ids.insert(root->id_);
+    ids.insert(a->id_);
+    ids.insert(b->id_);
+    ids.insert(pages->id_);
+    std::vector<uint64_t> pageIds;
+    for (int i = 0; i < 1000; i++)
+    {
+        pages->addChild(VirtualNode("page"));
+        pageIds.push_back(pages->children.back().id_);
+        ids.insert(pageIds.back());
+    }
+    assert(ids.size() == 1004);
+    assert(ids.count(0) == 0);
+
+    // ids and uris of virtual children survive the vector growing
+    for (int i = 0; i < 1000; i++)
+    {
+        assert(pages->children[i].id_ == pageIds[i]);
+        assert(pages->indexOfId(pageIds[i]) == i);
+        assert(pages->childId(i) == pageIds[i]);
+        assert(pages->indexOfUri(pages->children[i].uri_) == i);
+    }
+    assert(pages->childId(1000) == 0);
+
+    // the id index follows replaced, copied and directly appended children
+    VirtualNode original = pages->children[10];
+    VirtualNode replacement("replacement");
+    pages->setChild(10, replacement);
+    assert(pages->indexOfId(pageIds[10]) == -1);
+    assert(pages->indexOfId(replacement.id_) == 10);
+    pages->addChild(replacement);
+    assert(pages->indexOfId(replacement.id_) == 10);
+    pages->children.push_back(VirtualNode("appended"));
+    assert(pages->indexOfId(pages->children.back().id_) == 1001);
+    pages->children.pop_back();
+    pages->children.pop_back();
+    pages->reindex();
+    pages->setChild(10, original);
+    assert(pages->indexOfId(replacement.id_) == -1);
+    assert(pages->indexOfId(pageIds[10]) == 10);
+    assert(root->childId(1) == b->id_);
+    assert(root->childId(3) == 0);
+
+    Navi navi;
+    assert(navi.openMenu(root));
+    assert(NaviEngine::choiceId(NaviEngine::MenuState()) == 0);
+
+    assert(navi.selectNodeById(b->id_));
+    assert(navi.getCurrentNode() == b);
+    assert(navi.getCurrentChoice()->name_ == "b1");
+    assert(not navi.selectNodeById(a->id_));
+    assert(navi.getCurrentNode() == b);
+    assert(navi.up());
+
+    // virtual children are selected by id too
+    assert(navi.selectNodeById(pages->id_));
+    assert(navi.getCurrentNode() == pages);
+    moved = 0;
+    assert(navi.selectNodeById(pageIds[700]));
+    assert(navi.getCurrentChild() == 700);
+    assert(moved == 1);
+    assert(navi.selectNodeById(pageIds[700]));
+    assert(moved == 1);
+    assert(not navi.selectNodeById(12345678));
+    assert(navi.getCurrentChild() == 700);
+
+    // the choice id follows a virtual child moved in memory
+    pages->children.reserve(100000);
+    assert(navi.next());
+    assert(moved == 2);
+    assert(navi.getCurrentChild() == 701);
+
+    return 0;
+}
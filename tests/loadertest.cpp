@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "TreeLoader.h"
+#include "Nodes/MenuNode.h"
+#include "Nodes/VirtualMenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace naviengine;
+
+typedef TestNavi Navi;
+
+// load a description and return the error, or "ok"
+std::string load_error(const std::string& text)
+{
+    std::istringstream in(text);
+    TreeLoader loader;
+    MenuNode* root = loader.load(in);
+    if (root != NULL)
+    {
+        delete root;
+        return "ok";
+    }
+    std::ostringstream error;
+    error << loader.errorLine() << ": " << loader.error();
+    return error.str();
+}
+
+int main(int argc, char** argv)
+{
+    int books = (argc > 1) ? atoi(argv[1]) : 100000;
+
+    std::istringstream in(
+            "# a small library\n"
+            "shelf a\turn:a\tthe first shelf\n"
+            "    book 1\turn:a:1\n"
+            "        chapter 1\n"
+            "        chapter 2\r\n"
+            "\n"
+            "    book 2\n"
+            "shelf b\t\tno uri\n"
+            "  ~pages\turn:pages\n"
+            "    page 1\turn:p1\tfirst\n"
+            "    page 2\n"
+            "  book 3\n");
+    TreeLoader loader;
+    MenuNode* root = loader.load(in, "library");
+    assert(root != NULL);
+    assert(loader.error().empty() && loader.errorLine() == 0);
+    assert(loader.nodes() == 10);
+
+    assert(root->name_ == "library");
+    assert(root->numberOfChildren() == 2);
+    AnyNode* shelfA = root->childAt(0);
+    assert(shelfA->name_ == "shelf a" && shelfA->uri_ == "urn:a" && shelfA->info_ == "the first shelf");
+    assert(shelfA->numberOfChildren() == 2);
+    assert(shelfA->childAt(0)->uri_ == "urn:a:1");
+    assert(shelfA->childAt(0)->childAt(1)->name_ == "chapter 2");
+    assert(shelfA->childAt(1)->name_ == "book 2");
+    AnyNode* shelfB = root->childAt(1);
+    assert(shelfB->info_ == "no uri" && not shelfB->uri_.empty());
+    VirtualMenuNode* pages = dynamic_cast<VirtualMenuNode*>(shelfB->childAt(0));
+    assert(pages != NULL && pages->uri_ == "urn:pages");
+    assert(pages->children.size() == 2);
+    assert(pages->children[0].name_ == "page 1" && pages->children[0].uri_ == "urn:p1");
+    assert(pages->children[0].info_ == "first");
+    assert(shelfB->childAt(1)->name_ == "book 3");
+
+    // the loaded model can be navigated
+    Navi navi;
+    assert(navi.openMenu(root));
+    std::vector<std::string> path;
+    path.push_back("urn:a");
+    path.push_back("urn:a:1");
+    assert(navi.selectPath(path));
+    assert(navi.getCurrentChoice()->name_ == "chapter 1");
+
+    // invalid descriptions are reported with their line
+    assert(load_error("a\n  b\n c\n") == "3: indentation does not match any previous line");
+    assert(load_error("~a\n  b\n    c\n") == "3: virtual children can not have children");
+    assert(load_error("~a\n  ~b\n") == "2: virtual children can not be virtual menus");
+    assert(load_error("a\n  \turi\n") == "2: missing name");
+    assert(load_error("a\n    b\n  c\n") == "3: indentation does not match any previous line");
+    assert(load_error("a\n  b\nc\n  d\n") == "ok");
+    assert(load_error("") == "ok");
+    assert(loader.load(std::string("no such file")) == NULL);
+    assert(loader.error() == "can not open no such file");
+
+    // load throughput
+    std::ostringstream text;
+    for (int i = 0; i < books; i++)
+    {
+        if (i % 1000 == 0)
+            text << "shelf " << i / 1000 << "\turn:shelf:" << i / 1000 << "\n";
+        text << "  book " << i << "\turn:book:" << i << "\tby someone\n";
+        text << "    chapter 1\n    chapter 2\n";
+    }
+    std::string description = text.str();
+    std::istringstream big(description);
+    double start = seconds();
+    MenuNode* model = loader.load(big);
+    double time = seconds() - start;
+    assert(model != NULL);
+    assert(loader.nodes() == (size_t) books * 3 + (books + 999) / 1000);
+    std::cout << loader.nodes() << " nodes, " << description.size() / 1e6 << " MB in " << time << " s: "
+            << loader.nodes() / time << " nodes/s, " << description.size() / 1e6 / time << " MB/s" << std::endl;
+    delete model;
+
+    return 0;
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <string>
+#include <unistd.h>
+
+using namespace naviengine;
+
+// number of prepare calls currently running
+volatile int preparing = 0;
+
+class PreparedNode: public MenuNode
+{
+public:
+    PreparedNode(std::string name)
+        : MenuNode(name)
+    {
+        prepared_ = 0;
+        running_ = 0;
+    }
+
+    void prepare()
+    {
+        __sync_fetch_and_add(&preparing, 1);
+        __sync_fetch_and_add(&running_, 1);
+        usleep(1000);
+        __sync_fetch_and_add(&prepared_, 1);
+        __sync_fetch_and_sub(&running_, 1);
+        __sync_fetch_and_sub(&preparing, 1);
+    }
+
+    bool onOpen(NaviEngine& navi)
+    {
+        // the engine waits for the preparation of a node before its hooks
+        assert(__sync_fetch_and_add(&running_, 0) == 0);
+        return true;
+    }
+
+    volatile int prepared_;
+    volatile int running_;
+};
+
+// A node whose preparation runs until it is cancelled
+class SlowNode: public MenuNode
+{
+public:
+    SlowNode(std::string name)
+        : MenuNode(name)
+    {
+        started_ = 0;
+        cancelled_ = 0;
+        data_ = new char[16];
+    }
+
+    ~SlowNode()
+    {
+        delete[] data_;
+        data_ = 0;
+    }
+
+    void prepare()
+    {
+        __sync_fetch_and_add(&started_, 1);
+        for (int i = 0; i < 5000 && not prepareCancelled(); i++)
+        {
+            data_[i % 16] = i;
+            usleep(1000);
+        }
+        if (prepareCancelled())
+            __sync_fetch_and_add(&cancelled_, 1);
+    }
+
+    volatile int started_;
+    volatile int cancelled_;
+    char* data_;
+};
+
+typedef TestNavi Navi;
+
+bool waitForStarted(SlowNode* node)
+{
+    for (int i = 0; i < 1000; i++)
+    {
+        if (__sync_fetch_and_add(&node->started_, 0) > 0)
+            return true;
+        usleep(1000);
+    }
+    return false;
+}
+
+bool waitForCancelled(SlowNode* node)
+{
+    for (int i = 0; i < 1000; i++)
+    {
+        if (__sync_fetch_and_add(&node->cancelled_, 0) > 0)
+            return true;
+        usleep(1000);
+    }
+    return false;
+}
+
+bool waitForPrepared(PreparedNode* node)
+{
+    for (int i = 0; i < 1000; i++)
+    {
+        if (__sync_fetch_and_add(&node->prepared_, 0) > 0)
+            return true;
+        usleep(1000);
+    }
+    return false;
+}
+
+// browse a shared model with neighbours prepared
+void* browse_shared(void* model)
+{
+    Navi navi;
+    assert(navi.openSharedMenu(static_cast<MenuNode*>(model)));
+    navi.setPrepareNeighbours(true);
+    for (int i = 0; i < 200; i++)
+        assert((i / 50) % 2 == 0 ? navi.next() : navi.prev());
+    return NULL;
+}
+
+int main()
+{
+    PreparedNode* root = new PreparedNode("root");
+    PreparedNode* children[5];
+    for (int i = 0; i < 5; i++)
+    {
+        children[i] = new PreparedNode("child");
+        root->addNode(children[i]);
+        for (int j = 0; j < 3; j++)
+            children[i]->addNode(new PreparedNode("grandchild"));
+    }
+
+    Navi navi;
+    assert(navi.openMenu(root));
+
+    // nothing is prepared unless enabled
+    usleep(10000);
+    assert(__sync_fetch_and_add(&children[0]->prepared_, 0) == 0);
+
+    // enabling prepares the current choice and its neighbours
+    navi.setPrepareNeighbours(true);
+    assert(waitForPrepared(children[0]));
+    assert(waitForPrepared(children[1]));
+    assert(waitForPrepared(children[4]));
+
+    // moving prepares the new neighbours
+    assert(navi.next());
+    assert(navi.next());
+    assert(waitForPrepared(children[2]));
+    assert(waitForPrepared(children[3]));
+
+    // hammer the engine while preparations are running
+    for (int i = 0; i < 200; i++)
+    {
+        assert(navi.next());
+        if (i % 7 == 0)
+        {
+            assert(navi.select());
+            assert(navi.up());
+        }
+        if (i % 3 == 0)
+            assert(navi.prev());
+    }
+
+    // disabling stops the worker
+    navi.setPrepareNeighbours(false);
+    assert(__sync_fetch_and_add(&preparing, 0) == 0);
+    navi.setPrepareNeighbours(true);
+
+    // a command cancels a long preparation instead of waiting for it to finish
+    MenuNode* slowRoot = new MenuNode("slow");
+    SlowNode* slow[3];
+    for (int i = 0; i < 3; i++)
+    {
+        slow[i] = new SlowNode("slow child");
+        slowRoot->addNode(slow[i]);
+    }
+    Navi slowNavi;
+    assert(slowNavi.openMenu(slowRoot));
+    slowNavi.setPrepareNeighbours(true);
+    assert(waitForStarted(slow[0]));
+    assert(slowNavi.next());
+    // scheduling the new neighbours leaves the running preparation cancelled
+    assert(waitForCancelled(slow[0]));
+
+    // deleting a node waits for its preparation
+    assert(waitForStarted(slow[1]));
+    slowRoot->clearNodes();
+    slowNavi.setCurrentChoice(NULL);
+
+    // engines sharing a model schedule its nodes concurrently
+    MenuNode* shared = new MenuNode("shared");
+    for (int i = 0; i < 8; i++)
+        shared->addNode(new PreparedNode("shared child"));
+    pthread_t threads[2];
+    for (int i = 0; i < 2; i++)
+        pthread_create(&threads[i], NULL, browse_shared, shared);
+    for (int i = 0; i < 2; i++)
+        pthread_join(threads[i], NULL);
+    delete shared;
+
+    return 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "ModelPublisher.h"
+#include "Nodes/MenuNode.h"
+#include "Nodes/VirtualMenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string>
+#include <pthread.h>
+
+using namespace naviengine;
+
+int liveNodes = 0;
+
+class CatalogNode: public MenuNode
+{
+public:
+    CatalogNode(std::string name)
+        : MenuNode(name)
+    {
+        uri_ = name;
+        __sync_fetch_and_add(&liveNodes, 1);
+    }
+
+    ~CatalogNode()
+    {
+        __sync_fetch_and_sub(&liveNodes, 1);
+    }
+};
+
+class Navi: public TestNavi
+{
+public:
+    RenderDelta lastDelta;
+private:
+    void renderChange(const RenderDelta& delta)
+    {
+        lastDelta = delta;
+    }
+};
+
+// build a catalog, each revision adds one book to every shelf
+MenuNode* catalog_builder(int revision)
+{
+    MenuNode* root = new CatalogNode("catalog");
+    for (int i = 0; i < 3; i++)
+    {
+        std::string shelf = std::string("shelf ") + char('a' + i);
+        MenuNode* node = new CatalogNode(shelf);
+        root->addNode(node);
+        for (int j = 0; j < 3 + revision; j++)
+            node->addNode(new CatalogNode(shelf + ", book " + char('0' + j)));
+    }
+    return root;
+}
+
+// build a shelf and a virtual list, each revision drops the first item of the list
+MenuNode* list_builder(int revision)
+{
+    MenuNode* root = new CatalogNode("catalog");
+    MenuNode* shelf = new CatalogNode("shelf a");
+    root->addNode(shelf);
+    for (int j = 0; j < 3; j++)
+        shelf->addNode(new CatalogNode(std::string("shelf a, book ") + char('0' + j)));
+    VirtualMenuNode* list = new VirtualMenuNode("list");
+    list->uri_ = "list";
+    root->addNode(list);
+    for (int j = revision; j < 5; j++)
+    {
+        VirtualNode item(std::string("item ") + char('0' + j));
+        item.uri_ = item.name_;
+        list->addChild(item);
+    }
+    return root;
+}
+
+ModelPublisher* publisher = NULL;
+
+void* session(void* seed)
+{
+    unsigned int state = *static_cast<unsigned int*>(seed);
+    Navi navi;
+    assert(navi.openPublishedMenu(publisher));
+    for (int i = 0; i < 5000; i++)
+    {
+        switch (rand_r(&state) % 4)
+        {
+        case 0:
+            navi.next();
+            break;
+        case 1:
+            navi.prev();
+            break;
+        case 2:
+            navi.select();
+            break;
+        case 3:
+            navi.up();
+            break;
+        }
+        assert(navi.getCurrentNode() != NULL);
+    }
+    return NULL;
+}
+
+void* writer(void*)
+{
+    for (int i = 0; i < 200; i++)
+        publisher->publish(catalog_builder(i % 5));
+    return NULL;
+}
+
+int main()
+{
+    publisher = new ModelPublisher(catalog_builder(0));
+    assert(publisher->version() == 1);
+    int nodesPerRevision = liveNodes;
+
+    {
+        Navi navi;
+        assert(navi.openPublishedMenu(publisher));
+        assert(not navi.openPublishedMenu(publisher));
+        assert(navi.next());
+        assert(navi.select());
+        assert(navi.next());
+        assert(navi.next());
+        AnyNode* oldNode = navi.getCurrentNode();
+        assert(oldNode->uri_ == "shelf b");
+        assert(navi.getCurrentChoice()->uri_ == "shelf b, book 2");
+
+        // the engine keeps navigating the old version until its next command
+        publisher->publish(catalog_builder(1));
+        assert(publisher->version() == 2);
+        assert(liveNodes > nodesPerRevision);
+        assert(navi.getCurrentNode() == oldNode);
+
+        // the next command maps the state to the new version by uri
+        assert(navi.next());
+        assert(navi.getCurrentNode() != oldNode);
+        assert(navi.getCurrentNode()->uri_ == "shelf b");
+        assert(navi.getCurrentChoice()->uri_ == "shelf b, book 3");
+        assert(navi.numberOfChildren(navi.getCurrentNode()) == 4);
+
+        // the old version has been reclaimed
+        assert(liveNodes == nodesPerRevision + 3);
+
+        // a removed node is replaced by its closest ancestor
+        assert(navi.select());
+        assert(navi.getCurrentNode()->uri_ == "shelf b, book 3");
+        publisher->publish(catalog_builder(0));
+        assert(navi.next());
+        assert(navi.getCurrentNode()->uri_ == "shelf b");
+        assert(navi.getCurrentChoice()->uri_ == "shelf b, book 1");
+    }
+
+    // every open menu, the current virtual child and the render delta are mapped by uri
+    publisher->publish(list_builder(0));
+    {
+        Navi navi;
+        assert(navi.openPublishedMenu(publisher));
+        AnyNode* shelf = navi.getCurrentChoice();
+        assert(navi.next());
+        assert(navi.select());
+        assert(navi.getCurrentNode()->uri_ == "list");
+        for (int i = 0; i < 4; i++)
+            assert(navi.next());
+        assert(navi.getCurrentChild() == 4);
+        assert(navi.openSharedMenu(shelf));
+        assert(navi.next());
+
+        publisher->publish(list_builder(2));
+        assert(navi.next());
+        AnyNode* node = navi.getCurrentNode();
+        assert(node != shelf);
+        assert(node->uri_ == "shelf a");
+        assert(navi.getCurrentChoice()->uri_ == "shelf a, book 2");
+        assert(navi.lastDelta.before.currentNode == node);
+        assert(navi.lastDelta.changes & NaviEngine::MENU_CHANGED);
+
+        assert(navi.closeMenu());
+        assert(navi.getCurrentNode()->uri_ == "list");
+        assert(navi.getCurrentChild() == 2);
+        assert(navi.getCurrentNode()->childUri(navi.getCurrentChild()) == "item 4");
+
+        // the first virtual child becomes current when the current one was removed
+        publisher->publish(list_builder(5));
+        navi.prev();
+        assert(navi.getCurrentNode()->uri_ == "list");
+        assert(navi.getCurrentChild() == 0);
+    }
+
+    // versions no engine navigates are deleted when replaced
+    publisher->publish(catalog_builder(0));
+    assert(liveNodes == nodesPerRevision);
+
+    // sessions keep navigating while a writer publishes new versions
+    pthread_t threads[4];
+    unsigned int seeds[3];
+    for (int i = 0; i < 3; i++)
+    {
+        seeds[i] = i + 1;
+        pthread_create(&threads[i], NULL, session, &seeds[i]);
+    }
+    pthread_create(&threads[3], NULL, writer, NULL);
+    for (int i = 0; i < 4; i++)
+        pthread_join(threads[i], NULL);
+
+    delete publisher;
+    assert(liveNodes == 0);
+
+    return 0;
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "CommandLog.h"
+#include "ModelPublisher.h"
+#include "Nodes/MenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace naviengine;
+
+MenuNode* build_menu()
+{
+    MenuNode* menu = new MenuNode("menu");
+    menu->addNode(new MenuNode("help"));
+    menu->addNode(new MenuNode("settings"));
+    return menu;
+}
+
+class Navi: public TestNavi
+{
+public:
+    MenuNode* buildContextMenu()
+    {
+        return build_menu();
+    }
+};
+
+// The data object last given to a ProcessNode
+void* processed = NULL;
+
+// A node that moves to the next choice when processing a command
+class ProcessNode: public MenuNode
+{
+public:
+    ProcessNode(const std::string& name) :
+            MenuNode(name)
+    {
+    }
+
+    bool process(NaviEngine& navi, int command, void* data)
+    {
+        processed = data;
+        return navi.next();
+    }
+};
+
+MenuNode* build_model()
+{
+    MenuNode* root = new ProcessNode("root");
+    const char* uris[] = { "a", "b", "c" };
+    for (int i = 0; i < 3; i++)
+    {
+        MenuNode* node = new MenuNode(uris[i]);
+        node->uri_ = uris[i];
+        MenuNode* child = new MenuNode(std::string(uris[i]) + "1");
+        child->uri_ = child->name_;
+        node->addNode(child);
+        root->addNode(node);
+    }
+    // a node with the default uri made from its id
+    root->addNode(new MenuNode("d"));
+    return root;
+}
+
+// Supplies the menus and payloads of a replay
+class Source: public ReplaySource
+{
+public:
+    Source() :
+            shared(NULL), published(NULL)
+    {
+    }
+
+    void* payload(const CommandLog::Entry& entry)
+    {
+        sizes.push_back(entry.size);
+        return buffer;
+    }
+
+    AnyNode* menu(const CommandLog::Entry& entry)
+    {
+        return (entry.command == CommandLog::OPEN_SHARED_MENU) ? shared : build_menu();
+    }
+
+    ModelPublisher* publisher(const CommandLog::Entry& entry)
+    {
+        return published;
+    }
+
+    char buffer[16];
+    std::vector<int64_t> sizes;
+    AnyNode* shared;
+    ModelPublisher* published;
+};
+
+int main()
+{
+    char path[] = "/tmp/recordtestXXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    // commands given by the application are recorded, not those given by nodes
+    Navi navi;
+    assert(navi.openMenu(build_model()));
+    CommandLog log;
+    assert(not log.isOpen());
+    assert(log.open(path));
+    navi.setCommandLog(&log);
+    char payload[16] = { 0 };
+    payload[3] = 42;
+    assert(navi.process(7, payload, sizeof(payload)));
+    usleep(20000);
+    assert(navi.select());
+    assert(navi.up());
+    assert(navi.selectNodeByUri("c"));
+    uint64_t id = navi.getCurrentChoice()->id_;
+    assert(navi.selectNodeById(id));
+    assert(navi.top());
+    navi.beginBatch();
+    assert(navi.next());
+    assert(navi.commit());
+    assert(navi.prev());
+    assert(navi.openMenu(navi.buildContextMenu()));
+    assert(navi.next());
+    assert(navi.closeMenu());
+    std::string defaultUri = navi.getCurrentNode()->childAt(3)->uri_;
+    assert(navi.selectNodeByUri(defaultUri));
+    assert(navi.up());
+    assert(navi.process(1, payload));
+    std::vector<std::string> uris;
+    uris.push_back("b");
+    uris.push_back("b1");
+    assert(navi.selectPath(uris));
+    assert(navi.top());
+    std::vector<int> indices(1, 2);
+    assert(navi.selectPath(indices));
+    std::string current = navi.getCurrentNode()->uri_;
+    navi.setCommandLog(NULL);
+    assert(navi.next());
+    const size_t recorded = 19;
+    assert(log.size() == recorded);
+    assert(log.close());
+
+    std::vector<CommandLog::Entry> entries;
+    assert(CommandLog::read(path, entries));
+    assert(entries.size() == recorded);
+    CommandLog::Command commands[] = { CommandLog::PROCESS, CommandLog::SELECT, CommandLog::UP, CommandLog::SELECT_URI,
+            CommandLog::SELECT_ID, CommandLog::TOP, CommandLog::BEGIN_BATCH, CommandLog::NEXT, CommandLog::COMMIT,
+            CommandLog::PREV, CommandLog::OPEN_MENU, CommandLog::NEXT, CommandLog::CLOSE_MENU, CommandLog::SELECT_URI,
+            CommandLog::UP, CommandLog::PROCESS, CommandLog::SELECT_PATH, CommandLog::TOP, CommandLog::SELECT_INDICES };
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        assert(entries[i].command == commands[i]);
+        assert(i == 0 || entries[i].time >= entries[i - 1].time);
+    }
+    assert(entries[0].value == 7 && entries[0].size == sizeof(payload));
+    assert(entries[1].time >= 20000000);
+    assert(entries[3].uri == "c" && entries[3].value == 2);
+    assert(entries[4].value == 0);
+    assert(entries[13].uri == defaultUri && entries[13].value == 3);
+    assert(entries[15].value == 1 && entries[15].size == -1);
+    assert(entries[16].uris == uris);
+    assert(entries[18].indices == indices);
+    assert(std::string(CommandLog::name(entries[3].command)) == "selectNodeByUri");
+
+    // the state each command ended in is recorded
+    assert(entries[1].menus == 1 && entries[1].path.size() == 1 && entries[1].path[0] == 1);
+    assert(entries[10].menus == 2 && entries[10].path.empty());
+    assert(entries[11].choice == 1);
+    assert(entries[16].path.size() == 2 && entries[16].path[0] == 1 && entries[16].path[1] == 0);
+
+    // the log is compact, payloads are not recorded
+    struct stat info;
+    assert(stat(path, &info) == 0);
+    assert(info.st_size < (off_t) (8 + recorded * 12));
+
+    // replaying on a model built anew takes the recorded path, although ids and default uris differ
+    Navi replayed;
+    assert(replayed.openMenu(build_model()));
+    assert(replayed.getCurrentNode()->childAt(3)->uri_ != defaultUri);
+    std::vector<CommandLog::Result> results;
+    Source source;
+    assert(CommandLog::replay(replayed, entries, false, results, &source) == 0);
+    assert(results.size() == entries.size());
+    for (size_t i = 0; i < results.size(); i++)
+        assert(results[i].success && not results[i].diverged);
+    assert(replayed.getCurrentNode()->uri_ == current);
+
+    // payloads are supplied by the source with the recorded size
+    assert(source.sizes.size() == 2 && source.sizes[0] == sizeof(payload) && source.sizes[1] == -1);
+    assert(processed == source.buffer);
+
+    // without a source menus are not opened and nodes get no payload
+    Navi unsupplied;
+    assert(unsupplied.openMenu(build_model()));
+    assert(CommandLog::replay(unsupplied, entries, false, results) > 0);
+    assert(processed == NULL);
+    assert(not results[10].success && results[10].diverged);
+
+    // a replay that takes another path is reported
+    std::vector<CommandLog::Entry> changed = entries;
+    changed[4].value = 5;
+    Navi diverging;
+    assert(diverging.openMenu(build_model()));
+    assert(CommandLog::replay(diverging, changed, false, results) > 0);
+    assert(not results[4].success && results[4].diverged);
+
+    // real time replay reaches the same result
+    Navi paced;
+    assert(paced.openMenu(build_model()));
+    assert(CommandLog::replay(paced, entries, true, results, &source) == 0);
+
+    // a log that can not be written reports it
+    CommandLog full;
+    assert(full.open("/dev/full"));
+    navi.setCommandLog(&full);
+    navi.next();
+    assert(not full.isOpen());
+    assert(not full.close());
+    navi.setCommandLog(NULL);
+
+    // truncated logs are rejected
+    assert(truncate(path, info.st_size - 1) == 0);
+    assert(not CommandLog::read(path, entries));
+    assert(truncate(path, 4) == 0);
+    assert(not CommandLog::read(path, entries));
+    assert(not CommandLog::read("/nonexistent/log", entries));
+
+    // shared and published menus are recorded and replayed with the models of the source
+    MenuNode* shared = build_menu();
+    shared->uri_ = "shared";
+    ModelPublisher publisher(build_model());
+    {
+        Navi published;
+        assert(log.open(path));
+        published.setCommandLog(&log);
+        assert(published.openPublishedMenu(&publisher));
+        assert(published.openSharedMenu(shared));
+        assert(published.next());
+        assert(published.closeMenu());
+        assert(log.close());
+    }
+    assert(CommandLog::read(path, entries));
+    assert(entries.size() == 4);
+    assert(entries[0].command == CommandLog::OPEN_PUBLISHED_MENU);
+    assert(entries[1].command == CommandLog::OPEN_SHARED_MENU && entries[1].uri == "shared");
+    assert(std::string(CommandLog::name(entries[0].command)) == "openPublishedMenu");
+    {
+        Navi published;
+        source.shared = shared;
+        source.published = &publisher;
+        assert(CommandLog::replay(published, entries, false, results, &source) == 0);
+        assert(published.numberOfMenus() == 1);
+    }
+    delete shared;
+    unlink(path);
+
+    return 0;
+}
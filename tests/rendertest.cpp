@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "Nodes/VirtualMenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <string>
+
+using namespace naviengine;
+
+int deltas = 0;
+NaviEngine::RenderDelta lastDelta;
+
+// a node that grows a child each time it is opened
+class GrowingNode: public MenuNode
+{
+public:
+    GrowingNode(std::string name)
+        : MenuNode(name)
+    {
+    }
+
+    bool onOpen(NaviEngine& navi)
+    {
+        addNode(new MenuNode("new child"));
+        navi.markDirty(this, NaviEngine::CHILDREN_CHANGED);
+        if (navi.getCurrentChoice() == NULL)
+            navi.setCurrentChoice(firstChild());
+        return true;
+    }
+};
+
+class Navi: public TestNavi
+{
+private:
+    void renderChange(const RenderDelta& delta)
+    {
+        deltas++;
+        lastDelta = delta;
+    }
+};
+
+int main()
+{
+    MenuNode* root = new MenuNode("root");
+    MenuNode* first = new MenuNode("first");
+    root->addNode(first);
+    GrowingNode* growing = new GrowingNode("growing");
+    root->addNode(growing);
+    VirtualMenuNode* list = new VirtualMenuNode("list");
+    list->children.push_back(VirtualNode("item 1"));
+    list->children.push_back(VirtualNode("item 2"));
+    root->addNode(list);
+
+    Navi navi;
+    assert(navi.openMenu(root));
+    assert(deltas == 1);
+    assert(lastDelta.changes & NaviEngine::MENU_CHANGED);
+    assert(lastDelta.after.currentNode == root);
+
+    // moving the choice only reports the old and new choice
+    deltas = 0;
+    assert(navi.next());
+    assert(deltas == 1);
+    assert(lastDelta.changes == NaviEngine::CHOICE_MOVED);
+    assert(lastDelta.before.currentChoice == first);
+    assert(lastDelta.after.currentChoice == growing);
+    assert(lastDelta.nodes.empty());
+
+    // opening a node that inserts a child reports the node
+    deltas = 0;
+    assert(navi.select());
+    assert(deltas == 1);
+    assert(lastDelta.changes == (NaviEngine::NODE_OPENED | NaviEngine::CHOICE_MOVED | NaviEngine::CHILDREN_CHANGED));
+    assert(lastDelta.nodes.size() == 1);
+    assert(lastDelta.nodes[0].first == growing);
+    assert(lastDelta.nodes[0].second == NaviEngine::CHILDREN_CHANGED);
+
+    // a command that changes nothing is not reported
+    deltas = 0;
+    assert(navi.next());
+    assert(deltas == 0);
+
+    // moving in a virtual node reports the moved child
+    assert(navi.up());
+    assert(navi.next());
+    assert(navi.select());
+    deltas = 0;
+    assert(navi.next());
+    assert(deltas == 1);
+    assert(lastDelta.changes == NaviEngine::CHOICE_MOVED);
+    assert(lastDelta.before.currentChild == 0);
+    assert(lastDelta.after.currentChild == 1);
+
+    // changes made outside a command are reported with the next command
+    deltas = 0;
+    first->name_ = "renamed";
+    navi.markDirty(first, NaviEngine::CONTENT_CHANGED);
+    navi.markDirty(first, NaviEngine::CHILDREN_CHANGED);
+    assert(deltas == 0);
+    assert(navi.next());
+    assert(deltas == 1);
+    assert(lastDelta.changes == (NaviEngine::CHOICE_MOVED | NaviEngine::CONTENT_CHANGED | NaviEngine::CHILDREN_CHANGED));
+    assert(lastDelta.nodes.size() == 1);
+
+    // a batch is reported once, when committed
+    deltas = 0;
+    navi.beginBatch();
+    assert(navi.up());
+    assert(navi.prev());
+    assert(navi.prev());
+    assert(deltas == 0);
+    assert(navi.commit());
+    assert(deltas == 1);
+    assert(lastDelta.changes == (NaviEngine::NODE_OPENED | NaviEngine::CHOICE_MOVED));
+    assert(lastDelta.before.currentNode == list);
+    assert(lastDelta.after.currentNode == root);
+    assert(lastDelta.after.currentChoice == first);
+
+    return 0;
+}
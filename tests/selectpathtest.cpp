@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <string>
+#include <vector>
+
+using namespace naviengine;
+
+int onOpenCalls = 0;
+int onCloseCalls = 0;
+int narrateChanges = 0;
+
+class CountingNode: public MenuNode
+{
+public:
+    CountingNode(std::string name)
+        : MenuNode(name)
+    {
+        uri_ = name;
+    }
+
+    bool onOpen(NaviEngine& navi)
+    {
+        onOpenCalls++;
+        return true;
+    }
+};
+
+// a node that builds its children when opened
+class LazyNode: public CountingNode
+{
+public:
+    LazyNode(std::string name)
+        : CountingNode(name)
+    {
+    }
+
+    bool onOpen(NaviEngine& navi)
+    {
+        CountingNode::onOpen(navi);
+        if (firstChild() == NULL)
+        {
+            addNode(new CountingNode("chapter 1"));
+            addNode(new CountingNode("chapter 2"));
+        }
+        return true;
+    }
+
+    void onClose(NaviEngine& navi)
+    {
+        onCloseCalls++;
+        clearNodes();
+    }
+};
+
+// a node that opens a menu instead of selecting a child
+class PopupNode: public CountingNode
+{
+public:
+    PopupNode(std::string name)
+        : CountingNode(name)
+    {
+    }
+
+    bool select(NaviEngine& navi)
+    {
+        return navi.openMenu(new CountingNode("popup"), false);
+    }
+};
+
+class Navi: public TestNavi
+{
+private:
+    void narrateChange(const MenuState& before, const MenuState& after)
+    {
+        narrateChanges++;
+    }
+};
+
+MenuNode* menu_model_builder()
+{
+    MenuNode* root = new CountingNode("library");
+
+    MenuNode* author1 = new CountingNode("author 1");
+    root->addNode(author1);
+    MenuNode* author2 = new CountingNode("author 2");
+    root->addNode(author2);
+
+    author1->addNode(new CountingNode("book 1"));
+    author2->addNode(new CountingNode("book 2"));
+    author2->addNode(new LazyNode("book 3"));
+
+    MenuNode* author3 = new CountingNode("author 3");
+    root->addNode(author3);
+    author3->addNode(new LazyNode("book 4"));
+    MenuNode* popup = new PopupNode("popup shelf");
+    root->addNode(popup);
+    popup->addNode(new CountingNode("book 5"));
+
+    return root;
+}
+
+int main()
+{
+    Navi navi;
+
+    naviengine::MenuNode* model = menu_model_builder();
+    assert(navi.openMenu(model));
+    assert(navi.getCurrentNode()->name_ == "library");
+
+    // an empty path selects nothing
+    assert(not navi.selectPath(std::vector<std::string>()));
+    assert(not navi.selectPath(std::vector<int>()));
+
+    // descend through a lazily built book by uri, opening and narrating once
+    std::vector<std::string> uris;
+    uris.push_back("author 2");
+    uris.push_back("book 3");
+    uris.push_back("chapter 2");
+    onOpenCalls = 0;
+    narrateChanges = 0;
+    assert(navi.selectPath(uris));
+    assert(navi.getCurrentNode()->name_ == "chapter 2");
+    assert(navi.getCurrentNode()->parent_->name_ == "book 3");
+    // book 3 was opened silently to build its chapters, chapter 2 was opened for real
+    assert(onOpenCalls == 2);
+    assert(narrateChanges == 1);
+
+    assert(navi.top());
+    assert(navi.getCurrentChoice()->name_ == "author 2");
+
+    // descend by indices, book 3 already has children and is not opened
+    std::vector<int> indices;
+    indices.push_back(1);
+    indices.push_back(1);
+    indices.push_back(0);
+    onOpenCalls = 0;
+    narrateChanges = 0;
+    assert(navi.selectPath(indices));
+    assert(navi.getCurrentNode()->name_ == "chapter 1");
+    assert(onOpenCalls == 1);
+    assert(narrateChanges == 1);
+
+    // a broken path restores the previous state without narrating
+    assert(navi.top());
+    assert(navi.prev());
+    uris.clear();
+    uris.push_back("author 1");
+    uris.push_back("no such book");
+    onOpenCalls = 0;
+    narrateChanges = 0;
+    assert(not navi.selectPath(uris));
+    assert(navi.getCurrentNode()->name_ == "library");
+    assert(navi.getCurrentChoice()->name_ == "author 1");
+    assert(onOpenCalls == 0);
+    assert(narrateChanges == 0);
+
+    indices.clear();
+    indices.push_back(0);
+    indices.push_back(5);
+    assert(not navi.selectPath(indices));
+    assert(navi.getCurrentNode()->name_ == "library");
+    indices[1] = -1;
+    assert(not navi.selectPath(indices));
+    assert(navi.getCurrentNode()->name_ == "library");
+
+    // intermediate nodes opened along a broken path are closed again
+    uris.clear();
+    uris.push_back("author 3");
+    uris.push_back("book 4");
+    uris.push_back("no such chapter");
+    onOpenCalls = 0;
+    onCloseCalls = 0;
+    narrateChanges = 0;
+    assert(not navi.selectPath(uris));
+    assert(onOpenCalls == 1);
+    assert(onCloseCalls == 1);
+    assert(narrateChanges == 0);
+    assert(navi.getCurrentNode()->name_ == "library");
+    assert(navi.getCurrentChoice()->name_ == "author 1");
+    uris.pop_back();
+    assert(navi.selectPath(uris));
+    assert(navi.getCurrentNode()->name_ == "book 4");
+    assert(navi.numberOfChildren(navi.getCurrentNode()) == 2);
+
+    // a menu opened along a broken path is closed again
+    assert(navi.top());
+    uris.clear();
+    uris.push_back("popup shelf");
+    uris.push_back("book 5");
+    narrateChanges = 0;
+    assert(not navi.selectPath(uris));
+    assert(navi.numberOfMenus() == 1);
+    assert(navi.getCurrentNode()->name_ == "library");
+    assert(narrateChanges == 0);
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "Nodes/VirtualMenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string>
+#include <pthread.h>
+
+using namespace naviengine;
+
+typedef TestNavi Navi;
+
+MenuNode* menu_model_builder()
+{
+    MenuNode* root = new MenuNode("root");
+    for (int i = 0; i < 4; i++)
+    {
+        MenuNode* child = new MenuNode("child");
+        root->addNode(child);
+        for (int j = 0; j < 4; j++)
+            child->addNode(new MenuNode("grandchild"));
+    }
+
+    VirtualMenuNode* list = new VirtualMenuNode("list");
+    for (int i = 0; i < 10; i++)
+        list->children.push_back(VirtualNode("item"));
+    root->addNode(list);
+
+    return root;
+}
+
+MenuNode* model = NULL;
+
+// navigate the shared model at random and check the state stays consistent
+void* session(void* seed)
+{
+    unsigned int state = *static_cast<unsigned int*>(seed);
+    Navi navi;
+    assert(navi.openSharedMenu(model));
+
+    for (int i = 0; i < 20000; i++)
+    {
+        switch (rand_r(&state) % 4)
+        {
+        case 0:
+            navi.next();
+            break;
+        case 1:
+            navi.prev();
+            break;
+        case 2:
+            navi.select();
+            break;
+        case 3:
+            navi.up();
+            break;
+        }
+
+        AnyNode* node = navi.getCurrentNode();
+        assert(node != NULL);
+        assert(navi.getCurrentChild() >= 0 && navi.getCurrentChild() < 10);
+        if (navi.getCurrentChoice() != NULL && not node->isVirtual())
+            assert(navi.getCurrentChoice()->parent_ == node);
+    }
+    return NULL;
+}
+
+int main()
+{
+    model = menu_model_builder();
+
+    // two engines keep separate cursors in the same virtual node
+    {
+        Navi first;
+        Navi second;
+        assert(first.openSharedMenu(model));
+        assert(second.openSharedMenu(model));
+        assert(first.prev());
+        assert(second.prev());
+        assert(first.select());
+        assert(second.select());
+        assert(first.getCurrentNode()->name_ == "list");
+        assert(second.getCurrentNode() == first.getCurrentNode());
+
+        assert(first.next());
+        assert(first.next());
+        assert(second.prev());
+        assert(first.getCurrentChild() == 2);
+        assert(second.getCurrentChild() == 9);
+
+        // leaving the virtual node resets the cursor
+        assert(first.up());
+        assert(first.getCurrentChild() == 0);
+        assert(second.getCurrentChild() == 9);
+    }
+
+    // the model survives the engines that shared it, so many sessions can share it
+    pthread_t threads[4];
+    unsigned int seeds[4];
+    for (int i = 0; i < 4; i++)
+    {
+        seeds[i] = i + 1;
+        pthread_create(&threads[i], NULL, session, &seeds[i]);
+    }
+    for (int i = 0; i < 4; i++)
+        pthread_join(threads[i], NULL);
+
+    delete model;
+    return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "ModelPublisher.h"
+#include "Nodes/MenuLinkNode.h"
+#include "Nodes/MenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace naviengine;
+
+std::vector<std::string> narrated;
+int deleted = 0;
+
+class Navi: public TestNavi
+{
+private:
+    void narrate(const std::string text)
+    {
+        narrated.push_back(text);
+    }
+    void narrate(const int value)
+    {
+        std::ostringstream text;
+        text << value;
+        narrated.push_back(text.str());
+    }
+};
+
+// A node that counts its deletion
+class CountedNode: public MenuNode
+{
+public:
+    CountedNode(const std::string& name) :
+            MenuNode(name)
+    {
+    }
+
+    ~CountedNode()
+    {
+        deleted++;
+    }
+};
+
+// a settings menu to share, with fixed uris
+MenuNode* build_settings()
+{
+    MenuNode* settings = new CountedNode("settings");
+    MenuNode* volume = new MenuNode("volume");
+    volume->uri_ = "volume";
+    MenuNode* voice = new MenuNode("voice");
+    voice->uri_ = "voice";
+    MenuNode* level = new MenuNode("level");
+    level->uri_ = "level";
+    settings->addNode(volume);
+    settings->addNode(voice);
+    volume->addNode(level);
+    return settings;
+}
+
+// books and music menus both holding a link to the same settings
+MenuNode* build_model()
+{
+    MenuNode* settings = build_settings();
+    MenuNode* root = new MenuNode("root");
+    MenuNode* books = new MenuNode("books");
+    books->uri_ = "books";
+    MenuNode* music = new MenuNode("music");
+    music->uri_ = "music";
+    root->addNode(books);
+    root->addNode(music);
+
+    MenuLinkNode* link = new MenuLinkNode(settings);
+    link->uri_ = "books settings";
+    books->addNode(new MenuNode("book"));
+    books->addNode(link);
+    link = new MenuLinkNode(settings);
+    link->uri_ = "music settings";
+    music->addNode(link);
+    return root;
+}
+
+// narrate the current choice and return what was narrated
+std::string narrate_choice(Navi& navi)
+{
+    narrated.clear();
+    navi.narrateNode(navi.getCurrentChoice());
+    std::string text;
+    for (size_t i = 0; i < narrated.size(); i++)
+        text += narrated[i] + " ";
+    return text;
+}
+
+int main()
+{
+    MenuNode* root = build_model();
+    AnyNode* books = root->childAt(0);
+    AnyNode* music = root->childAt(1);
+    MenuLinkNode* booksSettings = static_cast<MenuLinkNode*>(books->childAt(1));
+    MenuLinkNode* musicSettings = static_cast<MenuLinkNode*>(music->childAt(0));
+    AnyNode* settings = booksSettings->target();
+
+    // the subtree is shared, not copied
+    assert(musicSettings->target() == settings);
+    assert(booksSettings->links() == 2);
+    assert(booksSettings->name_ == "settings");
+    assert(booksSettings->uri_ != musicSettings->uri_);
+    assert(booksSettings->childAt(1) == musicSettings->childAt(1));
+    assert(booksSettings->numberOfChildren() == 2);
+    assert(booksSettings->memoryUsage() < settings->memoryUsage() + settings->firstChild()->memoryUsage());
+    AnyNode* volume = settings->firstChild();
+
+    Navi navi;
+    assert(navi.openMenu(root));
+
+    // going up from a shared node returns through the link it was opened from
+    assert(navi.select());
+    assert(navi.next());
+    assert(navi.getCurrentChoice() == booksSettings);
+    assert(navi.select());
+    assert(navi.getCurrentNode() == booksSettings);
+    assert(navi.getCurrentChoice() == volume);
+    assert(narrate_choice(navi) == "1 volume ");
+    assert(navi.select());
+    assert(navi.getCurrentNode() == volume);
+    assert(navi.select());
+    assert(navi.up());
+    assert(navi.getCurrentNode() == volume);
+    assert(navi.up());
+    assert(navi.getCurrentNode() == booksSettings);
+    assert(navi.getCurrentChoice() == volume);
+    assert(navi.up());
+    assert(navi.getCurrentNode() == books);
+    assert(navi.getCurrentChoice() == booksSettings);
+    assert(navi.up());
+    assert(navi.getCurrentNode() == root);
+
+    // the same node opened through another parent returns there
+    assert(navi.next());
+    assert(navi.select());
+    assert(navi.select());
+    assert(navi.getCurrentNode() == musicSettings);
+    assert(navi.select());
+    assert(navi.getCurrentNode() == volume);
+    assert(navi.up());
+    assert(navi.getCurrentNode() == musicSettings);
+    assert(navi.up());
+    assert(navi.getCurrentNode() == music);
+
+    // a shared node reached by id, whose trail is rebuilt, also returns through the link
+    assert(navi.select());
+    assert(navi.getCurrentNode() == musicSettings);
+    assert(navi.selectNodeById(musicSettings->childId(1)));
+    assert(navi.getCurrentNode() == musicSettings->childAt(1));
+    assert(navi.up());
+    assert(navi.getCurrentNode() == musicSettings);
+    assert(navi.getCurrentChoice() == musicSettings->childAt(1));
+    assert(navi.up());
+    assert(navi.getCurrentNode() == music);
+
+    // top returns to the menu the shared node was opened from
+    assert(navi.select());
+    assert(navi.select());
+    assert(navi.getCurrentNode() == volume);
+    assert(navi.top());
+    assert(navi.getCurrentNode() == root);
+    assert(navi.getCurrentChoice() == music);
+
+    // the shared subtree is deleted with its last link
+    static_cast<MenuNode*>(books)->clearNodes();
+    assert(deleted == 0);
+    assert(musicSettings->links() == 1);
+    static_cast<MenuNode*>(music)->clearNodes();
+    assert(deleted == 1);
+
+    // published models keep the path through the link
+    deleted = 0;
+    ModelPublisher* publisher = new ModelPublisher(build_model());
+    {
+        Navi published;
+        assert(published.openPublishedMenu(publisher));
+        assert(published.next());
+        assert(published.select());
+        assert(published.select());
+        assert(published.select());
+        assert(published.getCurrentNode()->uri_ == "volume");
+
+        publisher->publish(build_model());
+        assert(deleted == 0);
+        assert(published.up());
+        assert(deleted == 1);
+        assert(published.getCurrentNode()->uri_ == "music settings");
+        assert(published.up());
+        assert(published.getCurrentNode()->uri_ == "music");
+    }
+    delete publisher;
+    assert(deleted == 2);
+
+    return 0;
+}
@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Seeded stress test
+ *
+ * Builds a large random model of MenuNodes and VirtualMenuNodes and fires
+ * random commands at it, checking the model and navigation invariants after
+ * every command.
+ *
+ * Usage: stresstest [seed] [commands] [nodes]
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "Nodes/VirtualMenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace naviengine;
+
+/**
+ * xorshift64* generator, so runs are reproducible on every platform
+ */
+class Random
+{
+public:
+    Random(unsigned long long seed) :
+            state_(seed * 2685821657736338717ULL + 1)
+    {
+    }
+
+    int below(int n)
+    {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return (int) (((state_ * 2685821657736338717ULL) >> 33) % n);
+    }
+
+private:
+    unsigned long long state_;
+};
+
+Random* rng = NULL;
+
+class StressNode: public MenuNode
+{
+public:
+    StressNode(std::string name)
+        : MenuNode(name)
+    {
+    }
+
+    bool menu(NaviEngine& navi)
+    {
+        if (rng->below(2) == 0)
+            return false;
+
+        MenuNode* root = new MenuNode("context menu");
+        for (int i = rng->below(3); i >= 0; i--)
+            root->addNode(new MenuNode("context item"));
+        return navi.openMenu(root);
+    }
+
+    bool onOpen(NaviEngine& navi)
+    {
+        return rng->below(10) != 0;
+    }
+
+    bool process(NaviEngine& navi, int command, void* data)
+    {
+        switch (command)
+        {
+        case 1:
+            // leave the menu
+            navi.setCurrentNode(NULL);
+            return true;
+        case 2:
+            // open the current choice
+            if (navi.getCurrentChoice() == NULL)
+                return false;
+            navi.setCurrentNode(navi.getCurrentChoice());
+            navi.setCurrentChoice(navi.getCurrentNode()->firstChild());
+            return true;
+        }
+        return false;
+    }
+};
+
+class StressVirtualNode: public VirtualMenuNode
+{
+public:
+    StressVirtualNode(std::string name)
+        : VirtualMenuNode(name)
+    {
+    }
+
+    bool selectByUri(NaviEngine& navi, std::string uri)
+    {
+        for (size_t i = 0; i < children.size(); i++)
+        {
+            if (children[i].uri_ == uri)
+            {
+                navi.setCurrentChild(i);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+typedef TestNavi Navi;
+
+/**
+ * Build a random tree by attaching each new node to a random existing menu node
+ */
+MenuNode* random_model_builder(int size)
+{
+    std::vector<MenuNode*> menus;
+    MenuNode* root = new StressNode("root");
+    menus.push_back(root);
+
+    for (int i = 1; i < size; i++)
+    {
+        std::ostringstream name;
+        name << "node " << i;
+        MenuNode* parent = menus[rng->below(menus.size())];
+
+        if (rng->below(8) == 0)
+        {
+            VirtualMenuNode* node = new StressVirtualNode(name.str());
+            for (int j = rng->below(20); j > 0; j--)
+                node->children.push_back(VirtualNode("virtual child"));
+            parent->addNode(node);
+        }
+        else
+        {
+            MenuNode* node = new StressNode(name.str());
+            parent->addNode(node);
+            menus.push_back(node);
+        }
+    }
+    return root;
+}
+
+/**
+ * Check the sibling ring and parent links of a node's children
+ */
+void check_children(const AnyNode* node)
+{
+    const AnyNode* first = node->firstChild();
+    if (first == NULL)
+        return;
+
+    int expected = const_cast<MenuNode*>(dynamic_cast<const MenuNode*>(node))->numberOfChildren();
+    int count = 0;
+    const AnyNode* child = first;
+    do
+    {
+        assert(child->parent_ == node);
+        assert(child->next_ != NULL && child->prev_ != NULL);
+        assert(child->next_->prev_ == child);
+        assert(child->prev_->next_ == child);
+        child = child->next_;
+        count++;
+        assert(count <= expected);
+    } while (child != first);
+    assert(count == expected);
+}
+
+/**
+ * Check every node in a model
+ */
+int check_model(const AnyNode* root)
+{
+    int nodes = 0;
+    std::vector<const AnyNode*> pending;
+    pending.push_back(root);
+    while (not pending.empty())
+    {
+        const AnyNode* node = pending.back();
+        pending.pop_back();
+        nodes++;
+        check_children(node);
+
+        const AnyNode* child = node->firstChild();
+        if (child != NULL)
+        {
+            do
+            {
+                pending.push_back(child);
+                child = child->next_;
+            } while (child != node->firstChild());
+        }
+    }
+    return nodes;
+}
+
+/**
+ * Check the navigation state of the engine
+ */
+void check_state(Navi& navi, int size)
+{
+    assert(navi.numberOfMenus() >= 1);
+
+    AnyNode* node = navi.getCurrentNode();
+    assert(node != NULL);
+
+    // the current node must be connected to the root of its menu
+    int depth = 0;
+    for (const AnyNode* ancestor = node; ancestor->parent_ != NULL; ancestor = ancestor->parent_)
+        assert(++depth < size);
+
+    if (node->isVirtual())
+    {
+        VirtualMenuNode* virtualNode = dynamic_cast<VirtualMenuNode*>(node);
+        assert(navi.getCurrentChild() >= 0);
+        assert(navi.getCurrentChild() < (int) virtualNode->children.size() || navi.getCurrentChild() == 0);
+    }
+    else
+    {
+        AnyNode* choice = navi.getCurrentChoice();
+        assert(choice == NULL || choice->parent_ == node);
+        check_children(node);
+    }
+}
+
+/**
+ * Pick the uri of a random child of the current node, or an invalid uri
+ */
+std::string random_uri(Navi& navi)
+{
+    AnyNode* node = navi.getCurrentNode();
+    if (node->isVirtual())
+    {
+        VirtualMenuNode* virtualNode = dynamic_cast<VirtualMenuNode*>(node);
+        if (not virtualNode->children.empty() && rng->below(4) != 0)
+            return virtualNode->children[rng->below(virtualNode->children.size())].uri_;
+    }
+    else if (node->firstChild() != NULL && rng->below(4) != 0)
+    {
+        AnyNode* child = node->firstChild();
+        for (int i = rng->below(8); i > 0; i--)
+            child = child->next_;
+        return child->uri_;
+    }
+    return "invalid uri";
+}
+
+double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long long seed = argc > 1 ? strtoull(argv[1], NULL, 10) : 1;
+    long commands = argc > 2 ? atol(argv[2]) : 1000000;
+    int size = argc > 3 ? atoi(argv[3]) : 50000;
+    rng = new Random(seed);
+
+    MenuNode* model = random_model_builder(size);
+    assert(check_model(model) == size);
+
+    Navi navi;
+    navi.openMenu(model);
+    check_state(navi, size);
+
+    int batches = 0;
+    double start = now();
+    for (long i = 0; i < commands; i++)
+    {
+        switch (rng->below(16))
+        {
+        case 0:
+        case 1:
+        case 2:
+            navi.next();
+            break;
+        case 3:
+        case 4:
+            navi.prev();
+            break;
+        case 5:
+        case 6:
+            navi.select();
+            break;
+        case 7:
+        case 8:
+            navi.up();
+            break;
+        case 9:
+            if (rng->below(8) == 0)
+                navi.top();
+            break;
+        case 10:
+            navi.selectNodeByUri(random_uri(navi));
+            break;
+        case 11:
+        {
+            std::vector<int> path;
+            for (int n = rng->below(3); n >= 0; n--)
+                path.push_back(rng->below(4));
+            navi.selectPath(path);
+            break;
+        }
+        case 12:
+            navi.openContextMenu();
+            break;
+        case 13:
+            navi.process(rng->below(4));
+            break;
+        case 14:
+            if (batches > 0 && rng->below(2) == 0)
+            {
+                navi.commit();
+                batches--;
+            }
+            else if (batches < 3)
+            {
+                navi.beginBatch();
+                batches++;
+            }
+            break;
+        case 15:
+            navi.narrateNode();
+            navi.renderNode(navi.getCurrentNode());
+            break;
+        }
+        check_state(navi, size);
+    }
+    while (batches-- > 0)
+        navi.commit();
+    double elapsed = now() - start;
+
+    assert(check_model(model) == size);
+
+    std::cout << "seed " << seed << ": " << commands << " commands on " << size << " nodes in "
+            << elapsed << " s (" << (long) (commands / (elapsed > 0 ? elapsed : 1e-9)) << " commands/s)"
+            << std::endl;
+
+    delete rng;
+    return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <iostream>
+#include <pthread.h>
+
+using namespace naviengine;
+
+const int NODES = 1000000;
+const size_t SMALL_STACK = 64 * 1024;
+
+int deleted = 0;
+int detached = 0;
+
+typedef TestNavi Navi;
+
+// A node that counts its deletion, checks it still has its children and counts
+// deletions without a parent
+class CountedNode: public MenuNode
+{
+public:
+    CountedNode(int children) :
+            MenuNode("counted"), children_(children)
+    {
+    }
+
+    ~CountedNode()
+    {
+        assert(numberOfChildren() == children_);
+        deleted++;
+        if (parent_ == NULL)
+            detached++;
+    }
+
+private:
+    int children_;
+};
+
+// a chain of nodes, each the only child of the one before
+MenuNode* build_deep(int nodes)
+{
+    MenuNode* root = new MenuNode("root");
+    MenuNode* node = root;
+    for (int i = 1; i < nodes; i++)
+    {
+        MenuNode* child = new MenuNode("section");
+        node->addNode(child);
+        node = child;
+    }
+    return root;
+}
+
+// a root with all other nodes as its children
+MenuNode* build_wide(int nodes)
+{
+    MenuNode* root = new MenuNode("root");
+    for (int i = 1; i < nodes; i++)
+        root->addNode(new MenuNode("page"));
+    return root;
+}
+
+// a book of parts, chapters, sections and pages
+MenuNode* build_book(int nodes)
+{
+    MenuNode* root = new MenuNode("book");
+    int count = 1;
+    while (count < nodes)
+    {
+        MenuNode* part = new MenuNode("part");
+        root->addNode(part);
+        count++;
+        for (int c = 0; c < 10 && count < nodes; c++)
+        {
+            MenuNode* chapter = new MenuNode("chapter");
+            part->addNode(chapter);
+            count++;
+            for (int s = 0; s < 10 && count < nodes; s++)
+            {
+                MenuNode* section = new MenuNode("section");
+                chapter->addNode(section);
+                count++;
+                for (int p = 0; p < 20 && count < nodes; p++, count++)
+                    section->addNode(new MenuNode("page"));
+            }
+        }
+    }
+    return root;
+}
+
+void* delete_node(void* node)
+{
+    delete static_cast<AnyNode*>(node);
+    return NULL;
+}
+
+void* clear_node(void* node)
+{
+    static_cast<MenuNode*>(node)->clearNodes();
+    return NULL;
+}
+
+void* delete_engine(void* navi)
+{
+    delete static_cast<Navi*>(navi);
+    return NULL;
+}
+
+// run a function on a thread with a small stack and return its duration
+double on_small_stack(void* (*function)(void*), void* argument)
+{
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, SMALL_STACK);
+    pthread_t thread;
+    double start = seconds();
+    assert(pthread_create(&thread, &attributes, function, argument) == 0);
+    pthread_join(thread, NULL);
+    double duration = seconds() - start;
+    pthread_attr_destroy(&attributes);
+    return duration;
+}
+
+int main()
+{
+    // derived destructors still see their children
+    CountedNode* counted = new CountedNode(2);
+    CountedNode* inner = new CountedNode(1);
+    counted->addNode(inner);
+    counted->addNode(new CountedNode(0));
+    inner->addNode(new CountedNode(0));
+    delete counted;
+    assert(deleted == 4);
+
+    // children are detached from their parent before it is deleted
+    assert(detached == 4);
+    MenuNode* parent = new MenuNode("parent");
+    inner = new CountedNode(1);
+    parent->addNode(inner);
+    inner->addNode(new CountedNode(0));
+    detached = 0;
+    parent->clearNodes();
+    assert(detached == 2);
+    delete parent;
+
+    // deep, wide and book shaped trees are deleted on a small stack
+    double deep = on_small_stack(delete_node, build_deep(NODES));
+    double wide = on_small_stack(delete_node, build_wide(NODES));
+    double book = on_small_stack(delete_node, build_book(NODES));
+    std::cout << "teardown of " << NODES << " nodes, deep " << deep << " s, wide " << wide << " s, book " << book
+            << " s" << std::endl;
+
+    // clearNodes deletes a deep subtree iteratively too
+    MenuNode* root = new MenuNode("root");
+    root->addNode(build_deep(NODES));
+    on_small_stack(clear_node, root);
+    assert(root->firstChild() == NULL);
+    delete root;
+
+    // closeMenu and the engine destructor delete deep models on a small stack
+    Navi* navi = new Navi();
+    assert(navi->openMenu(build_deep(NODES)));
+    assert(navi->openMenu(build_deep(NODES)));
+    assert(navi->closeMenu());
+    on_small_stack(delete_engine, navi);
+
+    return 0;
+}
@@ -47,6 +47,36 @@ class SimpleMenuNode: public MenuNode
     int onOpenVisits_;
 };
 
+class RootMenuNode: public MenuNode
+{
+    public:
+    RootMenuNode(std::string name)
+        : MenuNode(name)
+    {
+        onOpenVisits_ = 0;
+    }
+
+    bool onOpen(NaviEngine& navi)
+    {
+        onOpenVisits_++;
+        return true;
+    }
+
+    bool menu(NaviEngine& navi)
+    {
+        MenuNode* root = new MenuNode("menu root");
+        MenuNode* c1 = new MenuNode("menu child 1");
+        root->addNode(c1);
+        c1->addNode(new MenuNode("menu child 1, child 1"));
+        navi.openMenu(root);
+        return true;
+    }
+
+    int onOpenVisits_;
+};
+
+int narrateChanges = 0;
+
 class Navi: public NaviEngine
 {
 public:
@@ -57,6 +87,7 @@ public:
 private:
     void narrateChange(const MenuState& before, const MenuState& after)
     {
+        narrateChanges++;
     }
     void narrate(const std::string text)
     {
@@ -78,7 +109,7 @@ private:
 MenuNode* menu_model_builder()
 {
     // create root menu (level 0)
-    MenuNode* root = new MenuNode("root");
+    MenuNode* root = new RootMenuNode("root");
 
     // create 2 children for each child at level 0 (level 1)
     SimpleMenuNode* l1c1 = new SimpleMenuNode("level 1, child 1");
@@ -135,8 +166,38 @@ int main()
     assert(navi.getCurrentNode()->name_ == "level 3, child 1");
 
     // top should take as to the root without opening nodes on the way
+    RootMenuNode* root = static_cast<RootMenuNode*>(model);
+    root->onOpenVisits_ = 0;
+    narrateChanges = 0;
+    assert(navi.top());
+    assert(navi.getCurrentNode()->name_ == "root");
+    assert(navi.getCurrentChoice()->name_ == "level 1, child 1");
+    assert(root->onOpenVisits_ == 1);
+    assert(narrateChanges == 1);
+
+    // top on top level should open the root once and keep the choice
+    assert(navi.next());
+    root->onOpenVisits_ = 0;
+    narrateChanges = 0;
+    assert(navi.top());
+    assert(navi.getCurrentNode()->name_ == "root");
+    assert(navi.getCurrentChoice()->name_ == "level 1, child 2");
+    assert(root->onOpenVisits_ == 1);
+    assert(narrateChanges == 1);
+
+    // top should close stacked menus in one go
+    assert(navi.openContextMenu());
+    assert(navi.getCurrentNode()->name_ == "menu root");
+    assert(navi.select());
+    assert(navi.getCurrentNode()->name_ == "menu child 1");
+    root->onOpenVisits_ = 0;
+    narrateChanges = 0;
     assert(navi.top());
     assert(navi.getCurrentNode()->name_ == "root");
+    assert(navi.getCurrentChoice()->name_ == "level 1, child 2");
+    assert(root->onOpenVisits_ == 1);
+    assert(narrateChanges == 1);
+    assert(not navi.closeMenu());
 
     return 0;
 }
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Trace.h"
+#include "Nodes/MenuNode.h"
+#include "TestNavi.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace naviengine;
+
+typedef TestNavi Navi;
+
+// a node with a uri that needs escaping in JSON
+class QuotedNode: public MenuNode
+{
+public:
+    QuotedNode(const std::string& name) :
+            MenuNode(name)
+    {
+        uri_ = "urn:\"" + name + "\"";
+    }
+};
+
+int prepared = 0;
+
+// a node telling when it has been prepared
+class PreparedNode: public MenuNode
+{
+public:
+    PreparedNode(const std::string& name) :
+            MenuNode(name)
+    {
+    }
+
+    void prepare()
+    {
+        __sync_fetch_and_add(&prepared, 1);
+    }
+};
+
+size_t count(const std::string& text, const std::string& pattern)
+{
+    size_t found = 0;
+    for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1))
+        found++;
+    return found;
+}
+
+std::string trace()
+{
+    std::ostringstream out;
+    Trace::write(out);
+    return out.str();
+}
+
+// the thread number of the first event with a name
+int thread(const std::string& json, const std::string& name)
+{
+    size_t at = json.find("\"name\":\"" + name + "\"");
+    assert(at != std::string::npos);
+    at = json.find("\"tid\":", at);
+    assert(at != std::string::npos);
+    return atoi(json.c_str() + at + 6);
+}
+
+// trace more events than the buffer of a new thread keeps
+void* trace_many(void*)
+{
+    for (int i = 0; i < 100; i++)
+        TraceScope scope("many", NULL);
+    return NULL;
+}
+
+int main()
+{
+    MenuNode* root = new MenuNode("root");
+    root->uri_ = "urn:root";
+    MenuNode* book = new QuotedNode("book");
+    book->addNode(new MenuNode("chapter"));
+    root->addNode(book);
+    root->addNode(new PreparedNode("prepared"));
+
+    // nothing is recorded while disabled
+    assert(not Trace::enabled());
+    Navi navi;
+    assert(navi.openMenu(root));
+    assert(count(trace(), "\"ph\"") == 0);
+
+    Trace::enable();
+    assert(Trace::enabled());
+    assert(navi.select());
+    std::string json = trace();
+    assert(json.find("{\"traceEvents\":[") == 0);
+    assert(count(json, "\"name\":\"select\"") == 1);
+    assert(count(json, "\"name\":\"onOpen\"") == 1);
+    assert(count(json, "\"name\":\"beforeOnOpen\"") == 1);
+    assert(count(json, "\"name\":\"narrateChange\"") == 1);
+    // the command is traced with the node it started on, hooks with theirs
+    assert(json.find("\"name\":\"select\",\"cat\":\"naviengine\",\"ph\":\"X\"") != std::string::npos);
+    assert(json.find("\"args\":{\"uri\":\"urn:root\",\"menus\":1,\"nesting\":0}") != std::string::npos);
+    assert(json.find("\"args\":{\"uri\":\"urn:\\\"book\\\"\",\"menus\":1,\"nesting\":1}") != std::string::npos);
+
+    // events from before enabling again are not written
+    Trace::enable();
+    assert(navi.up());
+    json = trace();
+    assert(count(json, "\"name\":\"select\"") == 0);
+    assert(count(json, "\"name\":\"up\"") == 1);
+
+    // prepared nodes are traced in the preparing thread
+    navi.setPrepareNeighbours(true);
+    assert(navi.next());
+    while (__sync_fetch_and_add(&prepared, 0) == 0)
+        sched_yield();
+    navi.setPrepareNeighbours(false);
+    json = trace();
+    assert(count(json, "\"name\":\"prepare\"") >= 1);
+    assert(thread(json, "prepare") != thread(json, "next"));
+
+    // only the latest events of a thread are kept
+    Trace::enable(16);
+    pthread_t thread;
+    pthread_create(&thread, NULL, trace_many, NULL);
+    pthread_join(thread, NULL);
+    assert(count(trace(), "\"name\":\"many\"") == 16);
+
+    // enabling again drops the events of ended threads and resizes the buffers
+    Trace::enable(8);
+    assert(count(trace(), "\"name\":\"many\"") == 0);
+    pthread_create(&thread, NULL, trace_many, NULL);
+    pthread_join(thread, NULL);
+    assert(count(trace(), "\"name\":\"many\"") == 8);
+    for (int i = 0; i < 100; i++)
+        TraceScope scope("many", NULL);
+    assert(count(trace(), "\"name\":\"many\"") == 16);
+    Trace::enable();
+
+    // the cost of tracing is reported, not checked, as it depends on the machine and build
+    const int events = 200000;
+    double enabledTime = 1e9, disabledTime = 1e9, clockTime = 1e9;
+    for (int round = 0; round < 5; round++)
+    {
+        Trace::enable();
+        double start = seconds();
+        for (int i = 0; i < events; i++)
+            TraceScope scope("cheap", root, 1);
+        enabledTime = std::min(enabledTime, (seconds() - start) / events * 1e9);
+
+        Trace::disable();
+        start = seconds();
+        for (int i = 0; i < events; i++)
+            TraceScope scope("cheap", root, 1);
+        disabledTime = std::min(disabledTime, (seconds() - start) / events * 1e9);
+
+        start = seconds();
+        for (int i = 0; i < events; i++)
+            seconds();
+        clockTime = std::min(clockTime, (seconds() - start) / events * 1e9);
+    }
+    std::cout << "trace event: " << enabledTime << " ns enabled, " << disabledTime << " ns disabled, "
+            << clockTime << " ns per clock read" << std::endl;
+
+    assert(Trace::write(std::string("tracetest.json")));
+    remove("tracetest.json");
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "UriIndex.h"
+#include "Nodes/MenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace naviengine;
+
+int built = 0;
+
+typedef TestNavi Navi;
+
+std::string uri_of(int shelf, int book)
+{
+    std::ostringstream uri;
+    uri << "urn:book:" << shelf << ":" << book;
+    return uri.str();
+}
+
+// a shelf that builds its books when opened
+class ShelfNode: public MenuNode
+{
+public:
+    ShelfNode(int shelf) :
+            MenuNode("shelf"), shelf_(shelf)
+    {
+        std::ostringstream uri;
+        uri << "urn:shelf:" << shelf;
+        uri_ = uri.str();
+    }
+
+    bool onOpen(NaviEngine& navi)
+    {
+        if (firstChild() == NULL)
+        {
+            built++;
+            for (int i = 0; i < 1000; i++)
+            {
+                MenuNode* book = new MenuNode(uri_of(shelf_, i));
+                book->uri_ = uri_of(shelf_, i);
+                addNode(book);
+            }
+            if (navi.getCurrentNode() == this)
+                navi.setCurrentChoice(firstChild());
+        }
+        return true;
+    }
+
+private:
+    int shelf_;
+};
+
+int main()
+{
+    const int shelves = 100;
+    std::string path = "uriindextest.idx";
+
+    // the index is written without building the model
+    std::vector<UriIndex::Entry> entries;
+    for (int shelf = shelves - 1; shelf >= 0; shelf--)
+    {
+        std::vector<int> locator(1, shelf);
+        std::ostringstream uri;
+        uri << "urn:shelf:" << shelf;
+        entries.push_back(UriIndex::Entry(uri.str(), locator));
+        locator.push_back(0);
+        for (int book = 0; book < 1000; book++)
+        {
+            locator[1] = book;
+            entries.push_back(UriIndex::Entry(uri_of(shelf, book), locator));
+        }
+    }
+    entries.push_back(UriIndex::Entry(uri_of(0, 0), std::vector<int>(2, 7)));
+    assert(UriIndex::write(path, entries));
+    assert(entries.size() == shelves * 1001);
+
+    UriIndex index;
+    assert(not index.isOpen());
+    assert(not index.open("no such file"));
+    assert(index.open(path));
+    assert(index.size() == shelves * 1001);
+
+    std::vector<int> locator;
+    assert(index.lookup(uri_of(42, 917), locator));
+    assert(locator.size() == 2 && locator[0] == 42 && locator[1] == 917);
+    assert(index.lookup("urn:shelf:99", locator));
+    assert(locator.size() == 1 && locator[0] == 99);
+    // the first of duplicate uris is kept
+    assert(index.lookup(uri_of(0, 0), locator));
+    assert(locator.size() == 2 && locator[0] == 0 && locator[1] == 0);
+    assert(not index.lookup("urn:book", locator));
+    assert(not index.lookup("urn:book:99:1000", locator));
+    assert(not index.lookup("", locator));
+
+    MenuNode* root = new MenuNode("catalog");
+    for (int shelf = 0; shelf < shelves; shelf++)
+        root->addNode(new ShelfNode(shelf));
+
+    Navi navi;
+    assert(navi.openMenu(root));
+
+    // without the index only children of the current node are found
+    assert(not navi.selectNodeByUri(uri_of(42, 917)));
+    navi.setUriIndex(&index);
+
+    // with the index only the shelf on the way is built
+    assert(navi.selectNodeByUri(uri_of(42, 917)));
+    assert(navi.getCurrentNode()->uri_ == uri_of(42, 917));
+    assert(built == 1);
+    assert(navi.up());
+    assert(navi.getCurrentNode()->uri_ == "urn:shelf:42");
+    assert(navi.getCurrentChoice()->uri_ == uri_of(42, 917));
+
+    // children of the current node are still found directly
+    assert(navi.selectNodeByUri(uri_of(42, 3)));
+    assert(navi.getCurrentNode()->uri_ == uri_of(42, 3));
+
+    assert(navi.selectNodeByUri("urn:shelf:7"));
+    assert(navi.getCurrentNode()->uri_ == "urn:shelf:7");
+    assert(built == 2);
+
+    // unknown uris and stale locators leave the state alone
+    assert(not navi.selectNodeByUri("urn:unknown"));
+    assert(navi.getCurrentNode()->uri_ == "urn:shelf:7");
+    index.close();
+    std::vector<UriIndex::Entry> stale(1, UriIndex::Entry("urn:stale", std::vector<int>(2, 5000)));
+    assert(UriIndex::write(path, stale));
+    assert(index.open(path));
+    assert(not navi.selectNodeByUri("urn:stale"));
+    assert(navi.getCurrentNode()->uri_ == "urn:shelf:7");
+    assert(navi.up());
+    assert(navi.getCurrentNode() == root);
+
+    // an index can be collected from a built model
+    std::vector<UriIndex::Entry> collected;
+    UriIndex::collect(root, collected);
+    assert(collected.size() == shelves + 2000);
+    assert(UriIndex::write(path, collected));
+    assert(index.open(path));
+    assert(index.lookup(uri_of(7, 999), locator));
+    assert(locator.size() == 2 && locator[0] == 7 && locator[1] == 999);
+
+    index.close();
+    unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "Nodes/MenuViewNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace naviengine;
+
+std::vector<std::string> narrated;
+
+class Navi: public TestNavi
+{
+private:
+    void narrate(const std::string text)
+    {
+        narrated.push_back(text);
+    }
+    void narrate(const int value)
+    {
+        std::ostringstream text;
+        text << value;
+        narrated.push_back(text.str());
+    }
+};
+
+bool by_name_descending(const AnyNode* a, const AnyNode* b)
+{
+    return a->name_ > b->name_;
+}
+
+bool is_odd(const AnyNode* node)
+{
+    return (node->name_[node->name_.size() - 1] - '0') % 2 == 1;
+}
+
+// narrate the current choice and return what was narrated
+std::string narrate_choice(Navi& navi)
+{
+    narrated.clear();
+    navi.narrateNode(navi.getCurrentChoice());
+    std::string text;
+    for (size_t i = 0; i < narrated.size(); i++)
+        text += narrated[i] + " ";
+    return text;
+}
+
+int main()
+{
+    // the source is kept outside the model, the view is in it
+    MenuNode* books = new MenuNode("books");
+    for (int i = 0; i < 10; i++)
+    {
+        std::ostringstream name;
+        name << "book " << i;
+        MenuNode* book = new MenuNode(name.str());
+        book->addNode(new MenuNode("chapter"));
+        books->addNode(book);
+    }
+
+    MenuNode* root = new MenuNode("root");
+    MenuViewNode* view = new MenuViewNode(books, "odd books, last first");
+    root->addNode(new MenuNode("settings"));
+    root->addNode(view);
+
+    view->filter(is_odd);
+    view->sort(by_name_descending);
+    assert(view->numberOfChildren() == 5);
+    assert(view->firstChild()->name_ == "book 9");
+    assert(view->childAt(4)->name_ == "book 1");
+    assert(view->childAt(5) == NULL);
+    // the source is untouched
+    assert(books->numberOfChildren() == 10);
+    assert(books->firstChild()->name_ == "book 0");
+
+    // the engine owns the model, the source must outlive the engine
+    Navi* engine = new Navi;
+    Navi& navi = *engine;
+    assert(navi.openMenu(root));
+    assert(navi.next());
+    assert(navi.getCurrentChoice() == view);
+    assert(navi.select());
+    assert(navi.getCurrentNode() == view);
+    assert(navi.numberOfChildren(view) == 5);
+    assert(navi.getCurrentChoice()->name_ == "book 9");
+    assert(narrate_choice(navi) == "1 book 9 ");
+
+    assert(navi.next());
+    assert(navi.next());
+    assert(navi.getCurrentChoice()->name_ == "book 5");
+    assert(narrate_choice(navi) == "3 book 5 ");
+
+    // the view wraps around like a menu
+    assert(navi.prev());
+    assert(navi.prev());
+    assert(navi.prev());
+    assert(navi.getCurrentChoice()->name_ == "book 1");
+    assert(narrate_choice(navi) == "5 book 1 ");
+    assert(navi.next());
+    assert(navi.getCurrentChoice()->name_ == "book 9");
+    assert(navi.prev());
+
+    // going up from a book returns to its place in the view, not to the source
+    assert(navi.select());
+    assert(navi.getCurrentNode()->name_ == "book 1");
+    assert(navi.getCurrentChoice()->name_ == "chapter");
+    assert(navi.select());
+    assert(navi.up());
+    assert(navi.getCurrentNode()->name_ == "book 1");
+    assert(navi.up());
+    assert(navi.getCurrentNode() == view);
+    assert(navi.getCurrentChoice()->name_ == "book 1");
+    assert(navi.getCurrentChild() == 4);
+    assert(narrate_choice(navi) == "5 book 1 ");
+    assert(navi.next());
+    assert(navi.getCurrentChoice()->name_ == "book 9");
+    assert(navi.up());
+    assert(navi.getCurrentNode() == root);
+    assert(navi.getCurrentChoice() == view);
+
+    // a node reached by the path goes up to its parent
+    std::vector<int> path;
+    path.push_back(1);
+    path.push_back(2);
+    assert(navi.selectPath(path));
+    assert(navi.getCurrentNode()->name_ == "book 5");
+    assert(navi.up());
+    assert(navi.getCurrentNode() == view);
+    assert(navi.getCurrentChoice()->name_ == "book 5");
+    assert(navi.getCurrentChild() == 2);
+
+    // a book reached by id, whose trail is rebuilt, also returns to the view
+    assert(navi.selectNodeById(view->childAt(4)->id_));
+    assert(navi.getCurrentNode()->name_ == "book 1");
+    assert(navi.up());
+    assert(navi.getCurrentNode() == view);
+    assert(navi.getCurrentChoice()->name_ == "book 1");
+
+    // resorting the view keeps the choice
+    view->showAll();
+    assert(navi.numberOfChildren(view) == 10);
+    assert(navi.up());
+    assert(navi.select());
+    assert(navi.getCurrentNode() == view);
+    assert(navi.getCurrentChoice()->name_ == "book 0");
+    assert(navi.getCurrentChild() == 0);
+
+    // changing the source resets the view
+    view->filter(is_odd);
+    books->clearNodes();
+    books->addNode(new MenuNode("book 42"));
+    assert(navi.up());
+    assert(navi.select());
+    assert(navi.numberOfChildren(view) == 1);
+    assert(navi.getCurrentChoice()->name_ == "book 42");
+
+    // a source changed while the view is open resets the view on the next step
+    books->addNode(new MenuNode("book 43"));
+    books->addNode(new MenuNode("book 44"));
+    view->filter(is_odd);
+    assert(navi.up());
+    assert(navi.select());
+    assert(navi.getCurrentChoice()->name_ == "book 43");
+    assert(navi.getCurrentChild() == 0);
+    books->addNode(new MenuNode("book 45"));
+    assert(navi.next());
+    assert(navi.getCurrentChoice()->name_ == "book 44");
+    assert(navi.getCurrentChild() == 2);
+    assert(view->indexOf(books->childAt(3)) == 3);
+    assert(narrate_choice(navi) == "3 book 44 ");
+
+    // the choice is looked up when the view was sorted under it
+    view->sort(by_name_descending);
+    assert(narrate_choice(navi) == "2 book 44 ");
+    assert(navi.next());
+    assert(navi.getCurrentChoice()->name_ == "book 43");
+    assert(view->indexOf(books->firstChild()) == 3);
+    books->clearNodes();
+    books->addNode(new MenuNode("book 42"));
+
+    // an empty view has no choice
+    view->filter(is_odd);
+    assert(navi.up());
+    assert(navi.select());
+    assert(navi.getCurrentChoice() == NULL);
+    assert(not navi.next());
+    assert(not navi.prev());
+
+    delete engine;
+    delete books;
+
+    // a view whose source is deleted shows no children
+    MenuNode* source = new MenuNode("source");
+    source->addNode(new MenuNode("child"));
+    MenuViewNode* orphan = new MenuViewNode(source);
+    delete new MenuViewNode(source);
+    assert(orphan->numberOfChildren() == 1);
+    delete source;
+    assert(orphan->source() == NULL);
+    assert(orphan->numberOfChildren() == 0);
+    assert(orphan->firstChild() == NULL);
+    assert(orphan->indexOf(orphan) == -1);
+    delete orphan;
+    return 0;
+}
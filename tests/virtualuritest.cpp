@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "Nodes/VirtualMenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace naviengine;
+
+int changes = 0;
+
+class Navi: public TestNavi
+{
+private:
+    void narrateChange(const MenuState& before, const MenuState& after)
+    {
+        changes++;
+    }
+};
+
+VirtualNode page(int i)
+{
+    std::ostringstream name;
+    name << "page " << i;
+    VirtualNode node(name.str());
+    node.uri_ = "urn:" + name.str();
+    return node;
+}
+
+int main(int argc, char** argv)
+{
+    int pages = (argc > 1) ? atoi(argv[1]) : 1000000;
+
+    MenuNode* root = new MenuNode("root");
+    VirtualMenuNode* book = new VirtualMenuNode("book");
+    for (int i = 0; i < pages; i++)
+        book->addChild(page(i));
+    root->addNode(book);
+
+    Navi navi;
+    assert(navi.openMenu(root));
+    assert(navi.select());
+    assert(navi.getCurrentNode() == book);
+
+    // deep links set the current child
+    changes = 0;
+    assert(navi.selectNodeByUri(page(pages - 1).uri_));
+    assert(navi.getCurrentChild() == pages - 1);
+    assert(changes == 1);
+    assert(navi.selectNodeByUri(page(pages / 2).uri_));
+    assert(navi.getCurrentChild() == pages / 2);
+    assert(navi.selectNodeByUri(page(pages / 2).uri_));
+    assert(changes == 2);
+    assert(not navi.selectNodeByUri("urn:no such page"));
+    assert(navi.getCurrentChild() == pages / 2);
+
+    // lookups do not depend on the number of children
+    const int lookups = 1000000;
+    double start = seconds();
+    for (int i = 0; i < lookups; i++)
+    {
+        int index = (int) (((long long) i * 7919) % pages);
+        assert(book->indexOfUri(book->children[index].uri_) == index);
+    }
+    double time = (seconds() - start) / lookups * 1e9;
+    std::cout << pages << " children: " << time << " ns per lookup" << std::endl;
+
+    // replaced children are found by their new uri only
+    book->setChild(3, page(pages + 3));
+    assert(book->indexOfUri(page(3).uri_) == -1);
+    assert(book->indexOfUri(page(pages + 3).uri_) == 3);
+
+    // the first child with a uri is found
+    book->setChild(5, page(7));
+    assert(book->indexOfUri(page(7).uri_) == 5);
+    book->setChild(5, page(5));
+    assert(book->indexOfUri(page(7).uri_) == 7);
+
+    // children appended to the vector are found too, those replaced after a reindex
+    book->children.push_back(page(pages + 10));
+    assert(book->indexOfUri(page(pages + 10).uri_) == pages);
+    book->addChild(page(pages + 11));
+    assert(book->indexOfUri(page(pages + 10).uri_) == pages);
+    assert(book->indexOfUri(page(pages + 11).uri_) == pages + 1);
+    book->children.pop_back();
+    book->children.pop_back();
+    assert(book->indexOfUri(page(pages + 10).uri_) == -1);
+    assert(book->indexOfUri(page(pages + 11).uri_) == -1);
+    book->children[9] = page(pages + 9);
+    assert(book->indexOfUri(page(pages + 9).uri_) == -1);
+    assert(book->indexOfUri(page(9).uri_) == -1);
+    book->reindex();
+    assert(book->indexOfUri(page(pages + 9).uri_) == 9);
+
+    book->clearChildren();
+    assert(book->indexOfUri(page(0).uri_) == -1);
+    assert(not navi.selectNodeByUri(page(0).uri_));
+
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace naviengine;
+
+std::vector<std::string> narrated;
+
+class Navi: public TestNavi
+{
+private:
+    void narrate(const std::string text)
+    {
+        narrated.push_back(text);
+    }
+    void narrate(const int value)
+    {
+        std::ostringstream text;
+        text << value;
+        narrated.push_back(text.str());
+    }
+};
+
+// A node whose hooks take a given time
+class SlowNode: public MenuNode
+{
+public:
+    SlowNode(const std::string& name, int microseconds, bool async = false) :
+            MenuNode(name), delay(microseconds), async_(async), aborted(0)
+    {
+    }
+
+    bool onOpen(NaviEngine& navi)
+    {
+        if (async_)
+            navi.deferOpen(this);
+        usleep(delay);
+        return true;
+    }
+
+    bool onNarrate()
+    {
+        usleep(delay);
+        narrated.push_back("custom");
+        return true;
+    }
+
+    bool process(NaviEngine& navi, int command, void* data)
+    {
+        usleep(delay);
+        return true;
+    }
+
+    bool abort()
+    {
+        aborted++;
+        return true;
+    }
+
+    int delay;
+    bool async_;
+    int aborted;
+};
+
+// narrate the current choice and return what was narrated
+std::string narrate_choice(Navi& navi)
+{
+    narrated.clear();
+    navi.narrateNode(navi.getCurrentChoice());
+    std::string text;
+    for (size_t i = 0; i < narrated.size(); i++)
+        text += narrated[i] + " ";
+    return text;
+}
+
+int main()
+{
+    MenuNode* root = new MenuNode("root");
+    SlowNode* fast = new SlowNode("fast", 0);
+    SlowNode* slow = new SlowNode("slow", 20000);
+    SlowNode* loading = new SlowNode("loading", 20000, true);
+    root->addNode(fast);
+    root->addNode(slow);
+    root->addNode(loading);
+
+    Navi navi;
+    assert(navi.openMenu(root));
+
+    // nothing is counted without budgets
+    assert(navi.select());
+    assert(navi.up());
+    assert(navi.hookViolations().empty());
+
+    // hooks within their budget are not counted
+    navi.setHookBudget(NaviEngine::HOOK_OPEN, 5000);
+    navi.setHookBudget(NaviEngine::HOOK_PROCESS, 5000);
+    navi.setHookBudget(NaviEngine::HOOK_NARRATE, 5000);
+    assert(navi.select());
+    assert(navi.process(1));
+    assert(navi.up());
+    assert(narrate_choice(navi) == "custom ");
+    assert(navi.hookViolations().empty());
+
+    // slow hooks are counted per node type
+    assert(navi.next());
+    assert(navi.select());
+    assert(navi.good());
+    assert(navi.process(1));
+    assert(navi.process(2));
+    std::vector<NaviEngine::HookViolation> violations = navi.hookViolations();
+    assert(violations.size() == 2);
+    assert(violations[0].type == "SlowNode");
+    assert(violations[0].hook == NaviEngine::HOOK_OPEN);
+    assert(violations[0].count == 1);
+    assert(violations[0].worst >= 20000);
+    assert(violations[1].hook == NaviEngine::HOOK_PROCESS);
+    assert(violations[1].count == 2);
+    assert(slow->aborted == 0);
+
+    // a slow node type is narrated by the engine after exceeding the budget
+    assert(navi.up());
+    assert(narrate_choice(navi) == "custom ");
+    assert(narrate_choice(navi) == "2 slow ");
+    assert(navi.prev());
+    assert(narrate_choice(navi) == "1 fast ");
+    assert(navi.hookViolations().size() == 3);
+
+    // resetting lets the node type narrate itself again
+    navi.resetHookViolations();
+    assert(navi.hookViolations().empty());
+    assert(narrate_choice(navi) == "custom ");
+
+    // a node loading asynchronously is aborted when its onOpen is too slow
+    navi.setHookBudget(NaviEngine::HOOK_NARRATE, 0);
+    assert(navi.prev());
+    assert(navi.getCurrentChoice() == loading);
+    assert(not navi.select());
+    assert(not navi.good());
+    assert(not navi.openPending());
+    assert(loading->aborted == 1);
+    violations = navi.hookViolations();
+    assert(violations.size() == 1 && violations[0].hook == NaviEngine::HOOK_OPEN);
+
+    // an asynchronous open within the budget stays pending
+    loading->delay = 0;
+    assert(navi.up());
+    assert(navi.select());
+    assert(navi.openPending());
+    assert(loading->aborted == 1);
+    assert(navi.hookViolations()[0].count == 1);
+
+    return 0;
+}
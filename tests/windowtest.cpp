@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NaviEngine.h"
+#include "Nodes/MenuNode.h"
+#include "Nodes/VirtualMenuNode.h"
+#include "TestNavi.h"
+
+#include <assert.h>
+#include <sstream>
+#include <string>
+
+using namespace naviengine;
+
+typedef TestNavi Navi;
+
+std::string name_of(int i)
+{
+    std::ostringstream name;
+    name << "child " << i;
+    return name.str();
+}
+
+// check that a window holds the children first .. first + size - 1
+void check_window(const NaviEngine::Window& window, int total, int current, int first, int size, bool isVirtual)
+{
+    assert(window.total == total);
+    assert(window.current == current);
+    assert((int) window.entries.size() == size);
+    for (int i = 0; i < size; i++)
+    {
+        assert(window.entries[i].index == first + i);
+        if (isVirtual)
+            assert(window.entries[i].node == NULL);
+        else
+            assert(window.entries[i].node->name_ == name_of(first + i));
+    }
+}
+
+int main()
+{
+    const int count = 100000;
+    MenuNode* root = new MenuNode("root");
+    MenuNode* list = new MenuNode("list");
+    for (int i = 0; i < count; i++)
+        list->addNode(new MenuNode(name_of(i)));
+    root->addNode(list);
+
+    VirtualMenuNode* virtualList = new VirtualMenuNode("virtual list");
+    for (int i = 0; i < 20; i++)
+        virtualList->children.push_back(VirtualNode(name_of(i)));
+    root->addNode(virtualList);
+
+    Navi navi;
+    assert(navi.openMenu(root));
+
+    // the root has two children, both fit in the window
+    NaviEngine::Window window = navi.visibleWindow(3, 4);
+    assert(window.total == 2 && window.current == 0 && window.entries.size() == 2);
+    assert(window.entries[0].node == list);
+    assert(window.entries[1].node == virtualList);
+
+    assert(navi.select());
+    assert(navi.getCurrentNode() == list);
+
+    // at the start the window is moved to stay full
+    check_window(navi.visibleWindow(3, 4), count, 0, 0, 8, false);
+
+    // in the middle the window is around the choice
+    for (int i = 0; i < 50000; i++)
+        assert(navi.next());
+    check_window(navi.visibleWindow(3, 4), count, 50000, 49997, 8, false);
+    check_window(navi.visibleWindow(0, 0), count, 50000, 50000, 1, false);
+
+    // at the end the window is moved to stay full, also after wrapping
+    assert(navi.top());
+    assert(navi.select());
+    assert(navi.prev());
+    check_window(navi.visibleWindow(3, 4), count, count - 1, count - 8, 8, false);
+
+    // window of virtual children
+    assert(navi.up());
+    assert(navi.next());
+    assert(navi.select());
+    assert(navi.getCurrentNode() == virtualList);
+    check_window(navi.visibleWindow(3, 4), 20, 0, 0, 8, true);
+    for (int i = 0; i < 10; i++)
+        assert(navi.next());
+    check_window(navi.visibleWindow(3, 4), 20, 10, 7, 8, true);
+    assert(navi.prev());
+    assert(navi.prev());
+    check_window(navi.visibleWindow(2, 2), 20, 8, 6, 5, true);
+
+    // a window over many children is cheap to build
+    assert(navi.up());
+    assert(navi.prev());
+    assert(navi.select());
+    for (int i = 0; i < count; i++)
+    {
+        assert(navi.next());
+        assert(navi.visibleWindow(3, 4).current == (i + 1) % count);
+    }
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2012 Kolibre
+ *
+ * This file is part of kolibre-naviengine.
+ *
+ * Kolibre-naviengine is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Kolibre-naviengine is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with kolibre-naviengine. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replays a command log recorded with NaviEngine::setCommandLog against a
+ * model saved in the TreeLoader format and reports the latency of each kind
+ * of command. Context menus and menus opened by the application are loaded
+ * from the model given with --menu. Process commands are given no data
+ * object, and published menus can not be opened, as the log does not hold
+ * them. The commands after which the engine was not in the recorded state
+ * are reported, as the latencies of a replay that took another path than
+ * the recording are not comparable.
+ *
+ * Usage: naviengine-replay [--real-time] [--repeat N] [--menu MENU] MODEL LOG
+ */
+
+#include "NaviEngine.h"
+#include "CommandLog.h"
+#include "TreeLoader.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace naviengine;
+
+/**
+ * An engine that narrates nothing
+ */
+class ReplayEngine: public NaviEngine
+{
+public:
+    ReplayEngine(const std::string& menu) :
+            menu_(menu)
+    {
+    }
+
+    MenuNode* buildContextMenu()
+    {
+        if (menu_.empty())
+            return NULL;
+        TreeLoader loader;
+        return loader.load(menu_);
+    }
+private:
+    void narrateChange(const MenuState& before, const MenuState& after)
+    {
+    }
+    void narrate(const std::string text)
+    {
+    }
+    void narrate(const int value)
+    {
+    }
+    void narrateStop()
+    {
+    }
+    void narrateShortPause()
+    {
+    }
+    void narrateLongPause()
+    {
+    }
+
+    std::string menu_;
+};
+
+/**
+ * Supplies the menus opened by the application, loaded from --menu
+ */
+class MenuSource: public ReplaySource
+{
+public:
+    MenuSource(const std::string& menu) :
+            menu_(menu)
+    {
+    }
+
+    ~MenuSource()
+    {
+        for (size_t i = 0; i < shared_.size(); i++)
+            delete shared_[i];
+    }
+
+    AnyNode* menu(const CommandLog::Entry& entry)
+    {
+        if (menu_.empty())
+            return NULL;
+        TreeLoader loader;
+        MenuNode* menu = loader.load(menu_);
+        // Shared menus are not deleted by the engine
+        if (menu != NULL && entry.command == CommandLog::OPEN_SHARED_MENU)
+            shared_.push_back(menu);
+        return menu;
+    }
+
+private:
+    std::string menu_;
+    std::vector<MenuNode*> shared_;
+};
+
+void usage()
+{
+    std::cerr << "usage: naviengine-replay [--real-time] [--repeat N] [--menu MENU] MODEL LOG" << std::endl;
+}
+
+// the latency below which a fraction of the sorted latencies fall, in microseconds
+double percentile(const std::vector<uint64_t>& sorted, double fraction)
+{
+    size_t index = (size_t) (fraction * (sorted.size() - 1) + 0.5);
+    return sorted[index] / 1000.0;
+}
+
+int main(int argc, char* argv[])
+{
+    bool realTime = false;
+    int repeat = 1;
+    std::string menu;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--real-time") == 0)
+            realTime = true;
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+            repeat = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--menu") == 0 && i + 1 < argc)
+            menu = argv[++i];
+        else
+            files.push_back(argv[i]);
+    }
+    if (files.size() != 2 || repeat < 1)
+    {
+        usage();
+        return 2;
+    }
+
+    std::vector<CommandLog::Entry> entries;
+    if (not CommandLog::read(files[1], entries))
+    {
+        std::cerr << files[1] << ": not a command log" << std::endl;
+        return 1;
+    }
+
+    std::map<int, std::vector<uint64_t> > latencies;
+    size_t diverged = 0;
+    for (int run = 0; run < repeat; run++)
+    {
+        TreeLoader loader;
+        MenuNode* model = loader.load(files[0]);
+        if (model == NULL)
+        {
+            std::cerr << files[0] << ":" << loader.errorLine() << ": " << loader.error() << std::endl;
+            return 1;
+        }
+
+        // The source outlives the engine, which may have its shared menus open
+        MenuSource source(menu);
+        ReplayEngine navi(menu);
+        navi.openMenu(model);
+        std::vector<CommandLog::Result> results;
+        diverged = CommandLog::replay(navi, entries, realTime, results, &source);
+        bool reported = run > 0;
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            latencies[entries[i].command].push_back(results[i].latency);
+            if (results[i].diverged && not reported)
+            {
+                std::cerr << "command " << i + 1 << " (" << CommandLog::name(entries[i].command)
+                        << ") did not end in the recorded state" << std::endl;
+                reported = true;
+            }
+        }
+    }
+
+    std::cout << std::left << std::setw(18) << "command" << std::right << std::setw(10) << "count"
+            << std::setw(12) << "mean us" << std::setw(12) << "p50 us" << std::setw(12) << "p99 us"
+            << std::setw(12) << "max us" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::map<int, std::vector<uint64_t> >::iterator it;
+    for (it = latencies.begin(); it != latencies.end(); ++it)
+    {
+        std::vector<uint64_t>& sorted = it->second;
+        std::sort(sorted.begin(), sorted.end());
+        uint64_t total = 0;
+        for (size_t i = 0; i < sorted.size(); i++)
+            total += sorted[i];
+        std::cout << std::left << std::setw(18) << CommandLog::name((CommandLog::Command) it->first) << std::right
+                << std::setw(10) << sorted.size() << std::setw(12) << total / 1000.0 / sorted.size()
+                << std::setw(12) << percentile(sorted, 0.5) << std::setw(12) << percentile(sorted, 0.99)
+                << std::setw(12) << sorted.back() / 1000.0 << std::endl;
+    }
+    if (diverged > 0)
+    {
+        std::cerr << diverged << " of " << entries.size() << " commands did not end in the recorded state" << std::endl;
+        return 1;
+    }
+    return 0;
+}